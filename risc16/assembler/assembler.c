@@ -344,6 +344,10 @@ int main(int argc, char *argv[])
 		address++;
 
 	}
+
+	/* labels follow the code as ":addr name" lines, the loader keeps them as symbols */
+	for (i = 0; i < NumValidLabels; i++)
+		fprintf(outFilePtr, ":%04hx %s\n", Addresses[i], Labels[i]);
 }
 
 char * readAndParse(FILE *inFilePtr, char *lineString,
@@ -0,0 +1,248 @@
+#include "cache.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+static const char *POLICIES[3] = { "lru", "fifo", "random" };
+
+static uint8_t log2u(uint32_t x)
+{
+	uint8_t n = 0;
+	while (x >>= 1)
+		n++;
+	return n;
+}
+
+static bool pow2(const uint32_t x)
+{
+	return x && !(x & (x - 1));
+}
+
+/* cache unit BEGIN */
+cache_unit::cache_unit(const struct cache_config &cfg)
+{
+	this->cfg = cfg;
+	this->sets = cfg.size / (cfg.ways * cfg.line);
+	this->line_shift = log2u(cfg.line);
+	this->set_shift = log2u(this->sets);
+
+	this->tags.assign(this->sets * cfg.ways, 0);
+	this->meta.resize(this->sets * cfg.ways);
+	/* ranks start as a permutation so promote never has to fix them up */
+	for (uint32_t i = 0; i < this->meta.size(); i++)
+		this->meta[i] = i % cfg.ways;
+	this->next.assign(this->sets, 0);
+}
+
+uint32_t cache_unit::victim(const uint32_t set)
+{
+	const uint32_t base = set * this->cfg.ways;
+	for (uint32_t way = 0; way < this->cfg.ways; way++) {
+		if (!(this->meta[base + way] & CACHE_VALID))
+			return way;
+	}
+
+	uint32_t way = 0;
+	switch (this->cfg.policy) {
+	case CP_LRU:
+		for (uint32_t i = 0; i < this->cfg.ways; i++) {
+			if ((this->meta[base + i] & ~CACHE_VALID) == this->cfg.ways - 1)
+				way = i;
+		}
+		break;
+	case CP_FIFO:
+		way = this->next[set];
+		this->next[set] = (way + 1) & (this->cfg.ways - 1);
+		break;
+	case CP_RANDOM:
+		this->rng ^= this->rng << 13;
+		this->rng ^= this->rng >> 17;
+		this->rng ^= this->rng << 5;
+		way = this->rng & (this->cfg.ways - 1);
+		break;
+
+	default:
+		break;
+	};
+	return way;
+}
+
+/* way becomes rank 0, everything that was more recent ages by one */
+void cache_unit::promote(const uint32_t set, const uint32_t way)
+{
+	const uint32_t base = set * this->cfg.ways;
+	const uint8_t rank = this->meta[base + way] & ~CACHE_VALID;
+	for (uint32_t i = 0; i < this->cfg.ways; i++) {
+		if ((this->meta[base + i] & ~CACHE_VALID) < rank)
+			this->meta[base + i]++;
+	}
+	this->meta[base + way] &= CACHE_VALID;
+}
+
+/* true on a hit, a miss allocates the line */
+bool cache_unit::access(const uint16_t addr)
+{
+	const uint32_t set = (addr >> this->line_shift) & (this->sets - 1);
+	const uint16_t tag = addr >> (this->line_shift + this->set_shift);
+	const uint32_t base = set * this->cfg.ways;
+
+	for (uint32_t way = 0; way < this->cfg.ways; way++) {
+		if ((this->meta[base + way] & CACHE_VALID) && this->tags[base + way] == tag) {
+			if (this->cfg.policy == CP_LRU)
+				this->promote(set, way);
+			return true;
+		}
+	}
+
+	const uint32_t way = this->victim(set);
+	this->tags[base + way] = tag;
+	this->meta[base + way] |= CACHE_VALID;
+	if (this->cfg.policy == CP_LRU)
+		this->promote(set, way);
+	return false;
+}
+/* cache unit END */
+
+/* cache simulator BEGIN */
+cache_sim::cache_sim(mem_unit *mem, const char *path, const struct cache_config &icfg,
+		     const struct cache_config &dcfg) : icache(icfg), dcache(dcfg)
+{
+	this->mem = mem;
+	this->path = std::string(path);
+	this->icfg = icfg;
+	this->dcfg = dcfg;
+
+	this->ipc.assign(MEM_CAPACITY, cache_count());
+	this->dpc.assign(MEM_CAPACITY, cache_count());
+	this->ipage.assign(BUS_PAGES, cache_count());
+	this->dpage.assign(BUS_PAGES, cache_count());
+}
+
+void cache_sim::report(std::ostream &os, const char *name, const struct cache_config &cfg,
+		       const std::vector<struct cache_count> &pcs, const std::vector<struct cache_count> &pages)
+{
+	char line[128];
+	uint64_t hits = 0, misses = 0;
+	for (auto const& page : pages) {
+		hits += page.hits;
+		misses += page.misses;
+	}
+	const uint64_t all = hits + misses;
+	snprintf(line, sizeof(line), "# %s: %u words, %u-way, %u-word lines, %s\n", name,
+		 cfg.size, cfg.ways, cfg.line, POLICIES[cfg.policy]);
+	os << line;
+	snprintf(line, sizeof(line), "# %llu accesses, %llu misses, miss rate %.2f%%\n\n",
+		 static_cast<unsigned long long>(all), static_cast<unsigned long long>(misses),
+		 all ? 100.0 * misses / all : 0);
+	os << line;
+
+	os << "#  region               accesses        misses  miss %\n";
+	for (uint32_t page = 0; page < BUS_PAGES; page++) {
+		const struct cache_count &at = pages[page];
+		const uint64_t n = at.hits + at.misses;
+		if (!n)
+			continue;
+		snprintf(line, sizeof(line), "   0x%04x-0x%04x %14llu %13llu %7.2f\n", page << BUS_PAGE_SHIFT,
+			 ((page + 1) << BUS_PAGE_SHIFT) - 1, static_cast<unsigned long long>(n),
+			 static_cast<unsigned long long>(at.misses), 100.0 * at.misses / n);
+		os << line;
+	}
+
+	os << "\n#      accesses        misses  miss %      pc    word  instruction\n";
+	for (uint32_t pc = 0; pc < MEM_CAPACITY; pc++) {
+		const struct cache_count &at = pcs[pc];
+		const uint64_t n = at.hits + at.misses;
+		if (!n)
+			continue;
+		snprintf(line, sizeof(line), "  %12llu  %12llu %7.2f  ",
+			 static_cast<unsigned long long>(n), static_cast<unsigned long long>(at.misses),
+			 100.0 * at.misses / n);
+		os << line << disasm_at(this->mem, pc) << "\n";
+	}
+}
+
+enum GEN_ERR cache_sim::save(void)
+{
+	std::ofstream file(this->path, std::ios::trunc);
+	if (!file.is_open())
+		return E_IO;
+
+	this->report(file, "L1I", this->icfg, this->ipc, this->ipage);
+	file << "\n";
+	this->report(file, "L1D", this->dcfg, this->dpc, this->dpage);
+	return file ? E_OK : E_IO;
+}
+/* cache simulator END */
+
+/* "SIZE:WAYS:LINE[:POLICY]", sizes in words */
+enum GEN_ERR str2cache(const char *str, struct cache_config &cfg)
+{
+	std::stringstream list(str);
+	std::string field;
+	uint64_t nums[3];
+	for (uint8_t i = 0; i < 3; i++) {
+		if (!std::getline(list, field, ':') ||
+		    str2num(field.c_str(), 0, MEM_CAPACITY, nums[i]) != E_OK || !pow2(nums[i]))
+			return E_ARG;
+	}
+	struct cache_config parsed;
+	parsed.size = nums[0];
+	parsed.ways = nums[1];
+	parsed.line = nums[2];
+	if (parsed.ways > CACHE_MAX_WAYS || parsed.size > MEM_CAPACITY || parsed.ways * parsed.line > parsed.size)
+		return E_ARG;
+
+	/* getline can't tell "8" from "8:", an empty policy is not one */
+	if (str[strlen(str) - 1] == ':')
+		return E_ARG;
+	if (std::getline(list, field, ':')) {
+		if (field == "lru")
+			parsed.policy = CP_LRU;
+		else if (field == "fifo")
+			parsed.policy = CP_FIFO;
+		else if (field == "random")
+			parsed.policy = CP_RANDOM;
+		else
+			return E_ARG;
+	}
+	if (!list.eof())
+		return E_ARG;
+	cfg = parsed;
+	return E_OK;
+}
+
+/* control unit caches BEGIN */
+enum GEN_ERR ctrl_unit::set_caches(const char *path, const struct cache_config &icfg,
+				   const struct cache_config &dcfg)
+{
+	if (!path) {
+		this->caches.reset();
+		return E_OK;
+	}
+	this->caches = std::make_unique<cache_sim>(this->mem, path, icfg, dcfg);
+	return E_OK;
+}
+
+enum GEN_ERR ctrl_unit::save_caches(void)
+{
+	if (!this->caches)
+		return E_OK;
+	return this->caches->save();
+}
+
+void ctrl_unit::cache_instr(void)
+{
+	const uint16_t pc = this->reg->get_pc();
+	this->caches->fetch(pc);
+	if (this->instr.opcode != __LW && this->instr.opcode != __SW)
+		return;
+	/* the bus drops stores outside RAM_START..RAM_END - 1, they never get here */
+	const uint16_t addr = this->instr.imm + this->reg->read(this->instr.rB);
+	if (this->instr.opcode == __LW || (addr >= RAM_START && addr < RAM_END))
+		this->caches->data(pc, addr);
+}
+/* control unit caches END */
@@ -0,0 +1,113 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "modules.h"
+#include "cmdi.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#define CACHE_MAX_WAYS	64
+#define CACHE_VALID	0x80	/* meta bit, the rest is the replacement rank */
+
+enum CACHE_POLICY {
+	CP_LRU		= 0,
+	CP_FIFO		= 1,
+	CP_RANDOM	= 2
+};
+
+/* sizes in words, all powers of two */
+struct cache_config {
+	uint32_t size = 1024;
+	uint32_t ways = 2;
+	uint32_t line = 8;
+	enum CACHE_POLICY policy = CP_LRU;
+};
+
+struct cache_count {
+	uint64_t hits;
+	uint64_t misses;
+};
+
+/* one set associative cache: a uint16_t tag and a uint8_t valid/rank byte
+ * per line, nothing else, so a lookup touches one or two cache lines */
+class cache_unit {
+private:
+	/* private members BEGIN */
+	struct cache_config cfg;
+	uint32_t sets = 0;
+	uint8_t line_shift = 0;
+	uint8_t set_shift = 0;
+	uint32_t rng = 0x2545f491;
+
+	std::vector<uint16_t> tags;	/* set * ways + way */
+	std::vector<uint8_t> meta;
+	std::vector<uint8_t> next;	/* FIFO victim per set */
+	/* private members END */
+	/* private functions BEGIN */
+	uint32_t victim(const uint32_t set);
+	void promote(const uint32_t set, const uint32_t way);
+	/* private functions END */
+public:
+	cache_unit(const struct cache_config &cfg);
+	~cache_unit(void) = default;
+
+	bool access(const uint16_t addr);
+};
+
+/* split L1 caches fed by the switch core: fetches go to the I-cache, lw and
+ * sw to the D-cache, counted by the pc that made them and by the 256-word
+ * page they hit */
+class cache_sim {
+private:
+	/* private members BEGIN */
+	mem_unit *mem = nullptr;
+	std::string path;
+	struct cache_config icfg;
+	struct cache_config dcfg;
+	cache_unit icache;
+	cache_unit dcache;
+
+	std::vector<struct cache_count> ipc;	/* per pc */
+	std::vector<struct cache_count> dpc;
+	std::vector<struct cache_count> ipage;	/* per page */
+	std::vector<struct cache_count> dpage;
+	/* private members END */
+	/* private functions BEGIN */
+	void report(std::ostream &os, const char *name, const struct cache_config &cfg,
+		    const std::vector<struct cache_count> &pcs, const std::vector<struct cache_count> &pages);
+	/* private functions END */
+public:
+	cache_sim(mem_unit *mem, const char *path, const struct cache_config &icfg,
+		  const struct cache_config &dcfg);
+	~cache_sim(void) = default;
+
+	inline void fetch(const uint16_t pc)
+	{
+		const bool hit = this->icache.access(pc);
+		struct cache_count &at = this->ipc[pc];
+		struct cache_count &page = this->ipage[pc >> BUS_PAGE_SHIFT];
+		at.hits += hit;
+		at.misses += !hit;
+		page.hits += hit;
+		page.misses += !hit;
+	}
+	inline void data(const uint16_t pc, const uint16_t addr)
+	{
+		const bool hit = this->dcache.access(addr);
+		struct cache_count &at = this->dpc[pc];
+		struct cache_count &page = this->dpage[addr >> BUS_PAGE_SHIFT];
+		at.hits += hit;
+		at.misses += !hit;
+		page.hits += hit;
+		page.misses += !hit;
+	}
+
+	enum GEN_ERR save(void);
+};
+
+enum GEN_ERR str2cache(const char *str, struct cache_config &cfg);
+
+#endif
@@ -1,4 +1,11 @@
 #include "cmdi.h"
+#include "jit.h"
+#include "undo.h"
+#include "trace.h"
+#include "profile.h"
+#include "timing.h"
+#include "cache.h"
+#include "cond.h"
 #include "gen-err.h"
 #include "winpos.h"
 
@@ -6,16 +13,13 @@
 #include <algorithm>
 #include <string>
 #include <vector>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <sstream>
 #include <ncurses.h>
 
-static const uint16_t MASK_OP =		0xe000;
-static const uint16_t MASK_RA =		0x1c00;
-static const uint16_t MASK_RB =		0x0380;
-static const uint16_t MASK_RC =		0x0007;
-static const uint16_t MASK_LUI =	0xffc0;
-static const uint16_t MASK_IM7 =	0x007f;
-static const uint16_t MASK_IM10 =	0x03ff;
-
 static uint16_t clamp_ui16(uint16_t val, uint16_t min, uint16_t max)
 {
 	const uint32_t ret = (val < min) ? min : val;
@@ -23,49 +27,19 @@ static uint16_t clamp_ui16(uint16_t val, uint16_t min, uint16_t max)
 }
 
 /* instruction struct interface BEGIN */
+/* a single load from the table built in decode.cpp */
 enum GEN_ERR instr_t::decode(const uint16_t data)
 {
-	enum GEN_ERR retval = E_OK;
-
-	uint8_t rA = 0;
-	uint8_t rB = 0;
-	uint8_t rC = 0;
-	uint16_t imm = 0;
-	enum RISC16 opcode = static_cast<enum RISC16>((data & MASK_OP) >> 13);
+	const struct decoded_t dec = DECODE_TABLE[data];
 
-	switch (opcode) {
-	case __ADD:
-	case __NAND:
-		rA = (data & MASK_RA) >> 10;
-		rB = (data & MASK_RB) >> 7;
-		rC = data & MASK_RC;
-		break;
-	case __ADDI:
-	case __SW:
-	case __LW:
-	case __BEQ:
-	case __JALR:
-		rA = (data & MASK_RA) >> 10;
-		rB = (data & MASK_RB) >> 7;
-		imm = data & MASK_IM7;
-		break;
-	case __LUI:
-		rA = (data & MASK_RA) >> 10;
-		imm = data & MASK_IM10;
-		break;
-
-	default:
-		retval = E_ARG;
-		break;
-	};
-	this->opcode = opcode;
-	this->rA = rA;
-	this->rB = rB;
-	this->rC = rC;
-	this->imm = imm;
+	this->opcode = static_cast<enum RISC16>(dec.opcode);
+	this->rA = dec.rA;
+	this->rB = dec.rB;
+	this->rC = dec.rC;
+	this->imm = dec.imm;
 	this->raw_data = data;
 
-	return retval;
+	return (dec.handler == DEC_INVALID) ? E_ARG : E_OK;
 }
 
 const char *instr_t::__op2str(enum RISC16 opcode)
@@ -87,6 +61,8 @@ const char *instr_t::__op2str(enum RISC16 opcode)
 		return "beq";
 	case __JALR:
 		return "jalr";
+	case __EXT:
+		return ((this->imm >> 4) == EXT_SYSCALL) ? "sys" : "exc";
 
 	default:
 		return "INV";
@@ -105,11 +81,18 @@ void instr_t::draw(const uint32_t ypos, const uint32_t xpos)
 	case __LW:
 	case __BEQ:
 	case __JALR:
-		mvprintw(ypos + 1, xpos, "%s $r%d, $r%d, %u", __op2str(this->opcode), this->rA, this->rB, this->imm);
+		mvprintw(ypos + 1, xpos, "%s $r%d, $r%d, %d", __op2str(this->opcode), this->rA, this->rB,
+			 static_cast<int16_t>(this->imm));
 		break;
 	case __LUI:
 		mvprintw(ypos + 1, xpos, "%s $r%d, %u", __op2str(this->opcode), this->rA, this->imm);
 		break;
+	case __EXT:
+		if (this->imm == (EXT_EXCEPTION << 4 | EXC_HALT))
+			mvprintw(ypos + 1, xpos, "halt");
+		else
+			mvprintw(ypos + 1, xpos, "%s %u", __op2str(this->opcode), this->imm & 0xf);
+		break;
 
 	default:
 		mvprintw(ypos + 1, xpos, "invalid");
@@ -117,102 +100,90 @@ void instr_t::draw(const uint32_t ypos, const uint32_t xpos)
 	};
 	return;
 }
-/* instruction struct interface END */
 
-/* control unit interface BEGIN */
-	/* UNSAFE instruction functions BEGIN*/
-void ctrl_unit::__add(void)
+void instr_t::print(std::ostream &os)
 {
-	if (instr.rA)
-		reg->write(instr.rA, reg->read(instr.rB) + reg->read(instr.rC));
-
-	mem->rom_ptr = reg->get_pc();
-	reg->inc_pc();
-	return;
-}
-
-void ctrl_unit::__addi(void)
-{
-	if (instr.rA)
-		reg->write(instr.rA, reg->read(instr.rB) + instr.imm);
-
-	mem->rom_ptr = reg->get_pc();
-	reg->inc_pc();
-	return;
-}
-
-void ctrl_unit::__nand(void)
-{
-	if (instr.rA)
-		reg->write(instr.rA, ~(reg->read(instr.rB) & reg->read(instr.rC)));
-
-	mem->rom_ptr = reg->get_pc();
-	reg->inc_pc();
-	return;
-}
-
-void ctrl_unit::__lui(void)
-{
-	if (instr.rA)
-		reg->write(instr.rA, (instr.imm << 6) & MASK_LUI);
+	char buf[32];
+	switch (this->opcode) {
+	case __ADD:
+	case __NAND:
+		snprintf(buf, sizeof(buf), "%s $r%d, $r%d, $r%d", __op2str(this->opcode), this->rA, this->rB, this->rC);
+		break;
+	case __ADDI:
+	case __SW:
+	case __LW:
+	case __BEQ:
+	case __JALR:
+		snprintf(buf, sizeof(buf), "%s $r%d, $r%d, %d", __op2str(this->opcode), this->rA, this->rB,
+			 static_cast<int16_t>(this->imm));
+		break;
+	case __LUI:
+		snprintf(buf, sizeof(buf), "%s $r%d, %u", __op2str(this->opcode), this->rA, this->imm);
+		break;
+	case __EXT:
+		if (this->imm == (EXT_EXCEPTION << 4 | EXC_HALT))
+			snprintf(buf, sizeof(buf), "halt");
+		else
+			snprintf(buf, sizeof(buf), "%s %u", __op2str(this->opcode), this->imm & 0xf);
+		break;
 
-	mem->rom_ptr = reg->get_pc();
-	reg->inc_pc();
-	return;
+	default:
+		snprintf(buf, sizeof(buf), "invalid");
+		break;
+	};
+	os << buf;
 }
+/* instruction struct interface END */
 
-void ctrl_unit::__sw(void)
+/* control unit interface BEGIN */
+	/* UNSAFE instruction functions BEGIN*/
+void ctrl_unit::__ext(void)
 {
-	mem->ram_ptr = (instr.imm + reg->read(instr.rB));
-	if (mem->ram_ptr >= RAM_START && mem->ram_ptr < RAM_END)
-		mem->write(mem->ram_ptr, reg->read(instr.rA), false);
-
+	const uint8_t code = instr.imm & 0xf;
 	mem->rom_ptr = reg->get_pc();
-	reg->inc_pc();
-	return;
-}
 
-void ctrl_unit::__lw(void)
-{
-	mem->ram_ptr = (instr.imm + reg->read(instr.rB));
-	reg->write(instr.rA, mem->read(mem->ram_ptr));
+	/* halt, exit and exceptions leave $pc on themselves */
+	if ((instr.imm >> 4) == EXT_EXCEPTION) {
+		this->exc = code;
+		this->trap = (code == EXC_HALT) ? STOP_HALT : STOP_FAULT;
+		return;
+	}
+	if (code == SYS_EXIT) {
+		this->exit_code = reg->read(1);
+		this->trap = STOP_HALT;
+		return;
+	}
 
-	mem->rom_ptr = reg->get_pc();
+	/* syscalls without a host handler do nothing, replays after a
+	 * step-back don't reach the host but get the logged result */
+	uint16_t result;
+	if (this->syscalls[code] && !mem->is_muted()) {
+		result = this->syscalls[code](reg->read(1));
+		if (this->undo)
+			this->undo->record_result(this->retired, result);
+		reg->write(1, result);
+	} else if (this->syscalls[code] && this->undo && this->undo->replay_result(this->retired, result)) {
+		reg->write(1, result);
+	}
 	reg->inc_pc();
 	return;
 }
-
-void ctrl_unit::__beq(void)
-{
-	mem->rom_ptr = reg->get_pc();
-	if (reg->read(instr.rA) == reg->read(instr.rB))
-		reg->set_pc((reg->get_pc() + 1 + instr.imm) & MASK_IM7);
-	else
-		reg->inc_pc();
-
-	return;
-}
-
-void ctrl_unit::__jalr(void)
-{
-	/* in case if rA == rB */
-	uint16_t addr = reg->get_pc() + 1;
-	mem->rom_ptr = reg->get_pc();
-
-	reg->set_pc(reg->read(instr.rB));
-	if (instr.rA)
-		reg->write(instr.rA, addr);
-
-	return;
-}
 	/* UNSAFE instruction functions END */
 
+ctrl_unit::ctrl_unit(void) = default;
+ctrl_unit::~ctrl_unit(void) = default;
+
 enum GEN_ERR ctrl_unit::set_mem(mem_unit *mem)
 {
 	if (!mem)
 		return E_ARG;
 
 	this->mem = mem;
+	this->mem->set_ctrl(this);
+	this->dcache.resize(MEM_CAPACITY);
+	this->hcode.resize(MEM_CAPACITY);
+	this->tcode.resize(MEM_CAPACITY);
+	this->flush_dcache();
 	return E_OK;
 }
 
@@ -225,55 +196,63 @@ enum GEN_ERR ctrl_unit::set_reg(reg_unit *reg)
 	return E_OK;
 }
 
+void ctrl_unit::drop_decode(const uint16_t addr)
+{
+	this->dvalid.reset(addr);
+	this->tcode[addr] = this->tdecode;
+	if (this->jit)
+		this->jit->invalidate(addr);
+}
+
+void ctrl_unit::flush_dcache(void)
+{
+	this->dvalid.reset();
+	std::fill(this->tcode.begin(), this->tcode.end(), this->tdecode);
+	if (this->jit)
+		this->jit->flush();
+}
+
 enum GEN_ERR ctrl_unit::fetch(void)
 {
-	this->raw_data = this->mem->read(this->reg->get_pc());
+	const uint16_t pc = this->reg->get_pc();
+	/* predecoded words don't need to be read again */
+	if (!this->dvalid.test(pc))
+		this->raw_data = this->mem->read(pc);
 	return E_OK;
 }
 
 enum GEN_ERR ctrl_unit::decode(void)
 {
-	if (this->instr.decode(this->raw_data) != E_OK)
-		return E_ARG;
-
+	const uint16_t pc = this->reg->get_pc();
+	if (!this->dvalid.test(pc)) {
+		if (this->dcache[pc].decode(this->raw_data) != E_OK)
+			return E_ARG;
+		this->hcode[pc] = select(this->dcache[pc]);
+		this->dvalid.set(pc);
+	}
+	this->instr = this->dcache[pc];
+	this->handler = this->hcode[pc];
 	return E_OK;
 }
 
-enum GEN_ERR ctrl_unit::execute(void)
+void ctrl_unit::set_engine(const enum ENGINE engine)
 {
-	enum GEN_ERR retval = E_OK;
+	this->engine = engine;
+}
 
-	switch (instr.opcode) {
-	case __ADD:
-		__add();
-		break;
-	case __ADDI:
-		__addi();
-		break;
-	case __NAND:
-		__nand();
-		break;
-	case __LUI:
-		__lui();
-		break;
-	case __SW:
-		__sw();
-		break;
-	case __LW:
-		__lw();
-		break;
-	case __BEQ:
-		__beq();
-		break;
-	case __JALR:
-		__jalr();
-		break;
+void ctrl_unit::set_syscall(const uint8_t code, const sys_fn fn)
+{
+	if (code < SYS_CALLS && code != SYS_EXIT)
+		this->syscalls[code] = fn;
+}
 
-	default:
-		retval = E_ARG;
-		break;
-	};
-	return retval;
+enum GEN_ERR ctrl_unit::execute(void)
+{
+	if (!this->handler)
+		return E_ARG;
+
+	(this->*this->handler)();
+	return E_OK;
 }
 
 void ctrl_unit::flush_iobuf(void)
@@ -339,58 +318,317 @@ void ctrl_unit::cmd_jumptomem(void)
 void ctrl_unit::cmd_pokemem(void)
 {
 	this->mem->write(this->arg_addr, this->arg_data, true);
+	this->clear_history();
 	return;
 }
 
 void ctrl_unit::cmd_setpc(void)
 {
 	this->reg->set_pc(this->arg_addr);
+	this->clear_history();
 	return;
 }
 
 void ctrl_unit::cmd_exenticks(void)
 {
 	uint16_t ticks = this->arg_data;
-	while (ticks-- > 0) {
-		this->fetch();
-		this->decode();
-		this->execute();
-	}
+	this->trap = STOP_NONE;
+	while (ticks-- > 0 && !this->trap)
+		this->step();
+	this->report_trap();
+	return;
+}
+
+void ctrl_unit::cmd_stepback(void)
+{
+	const enum GEN_ERR retval = this->step_back(this->arg_data);
+	if (retval == E_INIT)
+		this->iobuf = std::string("err: undo history disabled");
+	else if (retval != E_OK)
+		this->iobuf = std::string("err: history too short");
+	return;
+}
+
+void ctrl_unit::cmd_runbacktobreak(void)
+{
+	const enum GEN_ERR retval = this->run_back_to_break();
+	if (retval == E_INIT)
+		this->iobuf = std::string("err: undo history disabled");
+	else if (retval != E_OK)
+		this->iobuf = std::string("err: no earlier breakpoint");
 	return;
 }
 
 void ctrl_unit::cmd_addbreak(void)
 {
-	this->bpoints.push_back(this->arg_addr);
-	this->bpoints.unique();
+	this->add_bpoint(this->arg_addr);
 	return;
 }
 
 void ctrl_unit::cmd_delbreak(void)
 {
-	this->bpoints.remove(this->arg_addr);
+	this->del_bpoint(this->arg_addr);
 	return;
 }
 
-void ctrl_unit::cmd_exetobreak(void)
+void ctrl_unit::cmd_condbreak(const std::string &cond)
 {
-	int32_t key = ERR;
-	std::list<uint16_t>::iterator it;
+	if (this->set_condition(this->arg_addr, cond) != E_OK)
+		this->iobuf = std::string("err: bad condition");
+	return;
+}
+
+/* watch-r/-w/-rw ADDR sets, unwatch ADDR drops all kinds */
+void ctrl_unit::cmd_watch(const std::string &cmd)
+{
+	uint8_t kind = WATCH_RW;
+	if (cmd == std::string("watch-r"))
+		kind = WATCH_R;
+	else if (cmd == std::string("watch-w"))
+		kind = WATCH_W;
+
+	enum GEN_ERR retval;
+	if (cmd == std::string("unwatch"))
+		retval = this->mem->del_watch(this->arg_addr, WATCH_RW);
+	else
+		retval = this->mem->add_watch(this->arg_addr, kind);
 
-	timeout(0);	// non-blocking
-	while ((key = getch()) == ERR) {
-		it = std::find(this->bpoints.begin(), this->bpoints.end(), this->reg->get_pc());
-		if(it != this->bpoints.end())
-			break;
+	if (retval == E_RANGE)
+		this->iobuf = std::string("err: only RAM can be watched");
+	else if (retval != E_OK)
+		this->iobuf = std::string("err: not watched");
+	return;
+}
 
-		this->fetch();
-		this->decode();
-		this->execute();
+void ctrl_unit::cmd_snapshot(const std::string &op, const std::string &path)
+{
+	if (op == std::string("save")) {
+		if (this->save_snapshot(path.c_str()) != E_OK)
+			this->iobuf = std::string("err: snapshot not saved");
+	} else if (op == std::string("load")) {
+		if (this->load_snapshot(path.c_str()) != E_OK)
+			this->iobuf = std::string("err: snapshot not loaded");
+		else
+			this->clear_history();
+	} else {
+		this->iobuf = std::string("err: snapshot save|load <file>");
 	}
-	timeout(-1);	// blocking
 	return;
 }
 
+/* tells the command line why a run to a breakpoint ended */
+void ctrl_unit::report_stop(const enum STOP_REASON reason)
+{
+	if (reason == STOP_IDLE)
+		this->iobuf = std::string("idle");
+	else
+		this->report_trap();
+	return;
+}
+
+/* tells the command line why the machine stopped on an EXT instruction or
+ * a watchpoint */
+void ctrl_unit::report_trap(void)
+{
+	char buf[IOBUF_SIZE];
+	if (this->trap == STOP_HALT && this->exc == EXC_HALT)
+		snprintf(buf, sizeof(buf), "halted");
+	else if (this->trap == STOP_HALT)
+		snprintf(buf, sizeof(buf), "exit %u", this->exit_code);
+	else if (this->trap == STOP_FAULT)
+		snprintf(buf, sizeof(buf), "exception %u", this->exc);
+	else if (this->trap == STOP_WATCH)
+		snprintf(buf, sizeof(buf), "%s 0x%04x at 0x%04x", (this->watch_kind == WATCH_W) ? "write" : "read",
+			 this->watch_addr, this->mem->rom_ptr);
+	else
+		return;
+	this->iobuf = std::string(buf);
+}
+
+enum GEN_ERR ctrl_unit::add_bpoint(const uint16_t addr)
+{
+	this->bpoints.set(addr);
+	this->conds.erase(addr);
+	this->drawn_bpoints = -1;
+	/* translated blocks may run straight through the new breakpoint */
+	if (this->jit)
+		this->jit->flush();
+	return E_OK;
+}
+
+enum GEN_ERR ctrl_unit::del_bpoint(const uint16_t addr)
+{
+	this->bpoints.reset(addr);
+	this->conds.erase(addr);
+	this->drawn_bpoints = -1;
+	return E_OK;
+}
+
+/* the condition is compiled once and only run when $pc reaches addr */
+enum GEN_ERR ctrl_unit::set_condition(const uint16_t addr, const std::string &cond)
+{
+	std::vector<uint16_t> code;
+	if (cond_compile(cond, this->mem->get_symbols(), code) != E_OK)
+		return E_ARG;
+
+	this->add_bpoint(addr);
+	this->conds[addr] = { cond, code };
+	this->drawn_bpoints = -1;
+	return E_OK;
+}
+
+const std::bitset<MEM_CAPACITY> &ctrl_unit::get_bpoints(void)
+{
+	return this->bpoints;
+}
+
+const std::map<uint16_t, struct bp_cond> &ctrl_unit::get_conds(void)
+{
+	return this->conds;
+}
+
+/* takes another machine's breakpoints, conditions come already compiled
+ * since this machine may not have the symbols they were compiled with */
+void ctrl_unit::set_bpoints(const std::bitset<MEM_CAPACITY> &bpoints, const std::map<uint16_t, struct bp_cond> &conds)
+{
+	this->bpoints = bpoints;
+	this->conds = conds;
+	this->drawn_bpoints = -1;
+	if (this->jit)
+		this->jit->flush();
+}
+
+/* for addresses in bpoints: stop unless a condition says otherwise */
+bool ctrl_unit::at_break(const uint16_t pc)
+{
+	auto const it = this->conds.find(pc);
+	return it == this->conds.end() || cond_eval(it->second.code, this->reg->rx.data(), pc, this->mem);
+}
+
+/* called by the bus on a watched access, the run loops stop on it like on
+ * a trapping EXT but only after the instruction finished */
+void ctrl_unit::hit_watch(const uint16_t addr, const uint8_t kind)
+{
+	this->trap = STOP_WATCH;
+	this->watch_addr = addr;
+	this->watch_kind = kind;
+}
+
+/* like run, but an instruction sitting on a breakpoint is stepped over */
+enum STOP_REASON ctrl_unit::resume(const uint64_t ticks)
+{
+	if (!ticks || !this->bpoints.test(this->reg->get_pc()))
+		return this->run(ticks);
+
+	this->trap = STOP_NONE;
+	if (this->step() != E_OK)
+		return STOP_FAULT;
+	if (this->trap)
+		return this->trap;
+	return (ticks == 1) ? STOP_BUDGET : this->run(ticks - 1);
+}
+
+/* runs up to ticks instructions without drawing anything */
+enum STOP_REASON ctrl_unit::run(const uint64_t ticks)
+{
+	if (!this->idle)
+		return this->run_core(ticks);
+
+	/* the cores never see the idle check, it runs between slices */
+	for (uint64_t left = ticks; left; ) {
+		const uint64_t slice = std::min<uint64_t>(left, POLL_TICKS);
+		const enum STOP_REASON reason = this->run_core(slice);
+		if (reason != STOP_BUDGET)
+			return reason;
+		if (this->stuck())
+			return STOP_IDLE;
+		left -= slice;
+	}
+	return STOP_BUDGET;
+}
+
+enum STOP_REASON ctrl_unit::run_core(const uint64_t ticks)
+{
+	/* only the switch core keeps the undo log, the trace, the profile and
+	 * the timing and cache models */
+	const bool hooked = this->undo || this->trace || this->profile || this->timing || this->caches;
+	this->trap = STOP_NONE;
+	if (this->engine == ENG_THREADED && !hooked)
+		return this->run_threaded(ticks);
+	if (this->engine == ENG_JIT && !hooked) {
+		/* translated loads and stores can't stop mid block, watched
+		 * runs fall back to the threaded core */
+		if (this->mem->is_watched())
+			return this->run_threaded(ticks);
+		return this->run_jit(ticks);
+	}
+
+	for (uint64_t i = 0; i < ticks; i++) {
+		if (this->bpoints.test(this->reg->get_pc()) && this->at_break(this->reg->get_pc()))
+			return STOP_BREAK;
+		if (this->step() != E_OK)
+			return STOP_FAULT;
+		if (this->trap)
+			return this->trap;
+	}
+	return STOP_BUDGET;
+}
+
+/* retires one instruction, logging its side effect when history is kept */
+enum GEN_ERR ctrl_unit::step(void)
+{
+	this->fetch();
+	if (this->decode() != E_OK)
+		return E_ARG;
+
+	if (this->undo) {
+		if (this->retired % UNDO_INTERVAL == 0)
+			this->undo->checkpoint(this->retired);
+		this->record_undo();
+	}
+	/* replays after a step-back were traced and counted the first time */
+	if (!this->mem->is_muted()) {
+		if (this->trace)
+			this->trace_instr();
+		if (this->profile)
+			this->profile_instr();
+		if (this->timing)
+			this->timing_instr();
+		if (this->caches)
+			this->cache_instr();
+	}
+
+	if (this->execute() != E_OK)
+		return E_ARG;
+	this->retired++;
+	return E_OK;
+}
+
+uint64_t ctrl_unit::get_retired(void)
+{
+	return this->retired;
+}
+
+uint16_t ctrl_unit::get_exit_code(void)
+{
+	return this->exit_code;
+}
+
+uint8_t ctrl_unit::get_exc(void)
+{
+	return this->exc;
+}
+
+uint16_t ctrl_unit::get_watch_addr(void)
+{
+	return this->watch_addr;
+}
+
+uint8_t ctrl_unit::get_watch_kind(void)
+{
+	return this->watch_kind;
+}
+
 enum GEN_ERR ctrl_unit::getline(void)
 {
 	enum GEN_ERR retval = E_OK;
@@ -423,6 +661,19 @@ enum GEN_ERR ctrl_unit::parseio(void)
 	std::string token;
 	std::vector<std::string> tokens;
 
+	/* add-b ADDR if CONDITION, the condition may hold spaces */
+	if (toparse.compare(0, 6, "add-b ") == 0 && (pos = toparse.find(" if ")) != std::string::npos) {
+		/* nothing is installed unless the whole address parses */
+		uint64_t addr = 0;
+		if (str2num(toparse.substr(6, pos - 6).c_str(), 16, UINT16_MAX, addr) != E_OK) {
+			this->iobuf = std::string("err: invalid address");
+			return retval;
+		}
+		this->arg_addr = addr;
+		this->cmd_condbreak(toparse.substr(pos + 4));
+		return retval;
+	}
+
 	/* split */
 	while ((pos = toparse.find(delim)) != std::string::npos) {
 		token = toparse.substr(0, pos);
@@ -432,7 +683,9 @@ enum GEN_ERR ctrl_unit::parseio(void)
 	tokens.push_back(toparse);
 
 	/* i don't like this, but whatever */
-	if (tokens.size() <= 1) {
+	if (tokens.size() == 1 && tokens[0] == std::string("run-back-to-break")) {
+		this->cmd_runbacktobreak();
+	} else if (tokens.size() <= 1) {
 		this->iobuf = std::string("err: too few arguments");
 		retval = E_ARG;
 		return retval;
@@ -450,29 +703,52 @@ enum GEN_ERR ctrl_unit::parseio(void)
 		} else if (tokens[0] == std::string("exe")) {
 			this->set_argdata_from_str(tokens[1]);
 			this->cmd_exenticks();
+		} else if (tokens[0] == std::string("step-back")) {
+			this->set_argdata_from_str(tokens[1]);
+			this->cmd_stepback();
 		} else if (tokens[0] == std::string("add-b")) {
 			this->set_argaddr_from_str(tokens[1]);
 			this->cmd_addbreak();
 		} else if (tokens[0] == std::string("del-b")) {
 			this->set_argaddr_from_str(tokens[1]);
 			this->cmd_delbreak();
+		} else if (tokens[0] == std::string("watch-r") || tokens[0] == std::string("watch-w") ||
+			   tokens[0] == std::string("watch-rw") || tokens[0] == std::string("unwatch")) {
+			this->set_argaddr_from_str(tokens[1]);
+			this->cmd_watch(tokens[0]);
 		}
 	} else if (tokens.size() == 3) {
 		if (tokens[0] == std::string("poke")) {
 			this->set_argaddr_from_str(tokens[1]);
 			this->set_argdata_from_str(tokens[2]);
 			this->cmd_pokemem();
+		} else if (tokens[0] == std::string("snapshot")) {
+			this->cmd_snapshot(tokens[1], tokens[2]);
 		}
 	}
 	return retval;
 }
 
+/* forces the next draw to repaint everything, e.g. after clear() */
+void ctrl_unit::touch(void)
+{
+	this->drawn_instr = -1;
+	this->drawn_bpoints = -1;
+}
+
 void ctrl_unit::draw(void)
 {
+	/* the previous instruction text isn't covered by the ROM pane */
+	if (this->drawn_instr >= 0)
+		mvprintw(this->drawn_instr + 1, X_INSTR, "%*s", X_RAM - X_INSTR - 1, "");
+	this->drawn_instr = -1;
+
 	/* draw instruction at current $pc position : REDO */
 	uint32_t ypos = mem->rom_ptr - mem->get_rom_beginp();
-	if (ypos <= VIEW_MEM_RANGE)
+	if (ypos <= VIEW_MEM_RANGE) {
 		instr.draw(ypos, X_INSTR);
+		this->drawn_instr = ypos;
+	}
 
 	/* draw previous cmd arguments */
 	mvprintw(Y_ARG_TITLE, X_ARGS, "CMD ARGS:");
@@ -481,14 +757,87 @@ void ctrl_unit::draw(void)
 
 	/* draw scan line area */
 	this->iobuf.resize(IOBUF_SIZE);
-	mvprintw(Y_SCANIN - 1, X_SCANIN, "%s", this->iobuf.c_str());
-
-	/* draw breakpoints : FIX -> something might break? */
-	for (auto const& it : this->bpoints) {
-		ypos = it - mem->get_rom_beginp() + 1;
-		if (ypos <= VIEW_MEM_RANGE)
-			mvprintw(ypos, X_ROM - 3, "[*]");
-	}
+	mvprintw(Y_SCANIN - 1, X_SCANIN, "%-*s", IOBUF_SIZE - 1, this->iobuf.c_str());
+
+	/* draw breakpoints in the visible ROM range, blanking removed ones,
+	 * only after they change or the pane scrolls */
+	const uint32_t begin = mem->get_rom_beginp();
+	if (this->drawn_bpoints == static_cast<int32_t>(begin))
+		return;
+	this->drawn_bpoints = begin;
+	for (uint32_t addr = begin; addr <= begin + VIEW_MEM_RANGE && addr < MEM_CAPACITY; addr++)
+		mvprintw(addr - begin + 1, X_ROM - 3, !this->bpoints.test(addr) ? "   " : this->conds.count(addr) ? "[?]" : "[*]");
 	return;
 }
-/* control unit interface END */
\ No newline at end of file
+/* control unit interface END */
+
+enum GEN_ERR str2engine(const char *str, enum ENGINE &engine)
+{
+	if (!strcmp(str, "switch"))
+		engine = ENG_SWITCH;
+	else if (!strcmp(str, "threaded"))
+		engine = ENG_THREADED;
+	else if (!strcmp(str, "jit"))
+		engine = ENG_JIT;
+	else
+		return E_ARG;
+
+	return E_OK;
+}
+
+/* the whole string as a number no larger than max, without sign or
+ * leading blanks */
+enum GEN_ERR str2num(const char *str, const int base, const uint64_t max, uint64_t &num)
+{
+	if (!isxdigit(static_cast<unsigned char>(*str)))
+		return E_ARG;
+
+	char *end = nullptr;
+	errno = 0;
+	const unsigned long long val = strtoull(str, &end, base);
+	if (end == str || *end || errno == ERANGE || val > max)
+		return E_ARG;
+
+	num = val;
+	return E_OK;
+}
+
+const char *stop2str(const enum STOP_REASON reason)
+{
+	switch (reason) {
+	case STOP_NONE:
+		return "none";
+	case STOP_BUDGET:
+		return "budget";
+	case STOP_BREAK:
+		return "break";
+	case STOP_FAULT:
+		return "fault";
+	case STOP_HALT:
+		return "halt";
+	case STOP_IDLE:
+		return "idle";
+	case STOP_WATCH:
+		return "watch";
+
+	default:
+		return "INV";
+	};
+}
+
+/* "pc  word  instruction" columns of the report writers, the word is read
+ * behind the bus so devices and watchpoints never see a report */
+std::string disasm_at(mem_unit *mem, const uint16_t addr)
+{
+	uint16_t word;
+	mem->read_block(addr, &word, 1);
+
+	char buf[32];
+	snprintf(buf, sizeof(buf), "0x%04x  0x%04x  ", addr, word);
+	std::ostringstream text;
+	text << buf;
+	instr_t instr;
+	instr.decode(word);
+	instr.print(text);
+	return text.str();
+}
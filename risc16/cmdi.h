@@ -1,9 +1,29 @@
+#ifndef CMDI_H
+#define CMDI_H
+
 #include "modules.h"
 
 #include <cstdint>
-#include <list>
+#include <array>
+#include <vector>
+#include <bitset>
+#include <memory>
+#include <map>
+#include <string>
+#include <ostream>
+#include <functional>
+
+#define IOBUF_SIZE 57	/* room for add-b ADDR if CONDITION, the scan line sets TERMX_MIN */
+#define POLL_TICKS (1 << 16)	/* instructions between keyboard polls */
+#define IDLE_PROBE 256		/* longest loop the idle check can prove stuck */
 
-#define IOBUF_SIZE 33
+static const uint16_t MASK_OP =		0xe000;
+static const uint16_t MASK_RA =		0x1c00;
+static const uint16_t MASK_RB =		0x0380;
+static const uint16_t MASK_RC =		0x0007;
+static const uint16_t MASK_LUI =	0xffc0;
+static const uint16_t MASK_IM7 =	0x007f;
+static const uint16_t MASK_IM10 =	0x03ff;
 
 enum RISC16 {
 	__ADD	= 0,
@@ -13,7 +33,71 @@ enum RISC16 {
 	__SW	= 4,
 	__LW	= 5,
 	__BEQ	= 6,
-	__JALR	= 7
+	__JALR	= 7,
+	__EXT	= 8	/* jalr $r0, $r0 with an EXT_* subtype in imm bits 4-6 */
+};
+
+#define DECODE_WORDS	(1 << 16)
+#define DEC_INVALID	15	/* handler index of words that don't decode */
+
+/* one instruction word decoded at compile time, see decode.cpp */
+struct decoded_t {
+	uint32_t handler	: 4;	/* enum RISC16 or DEC_INVALID */
+	uint32_t opcode		: 4;
+	uint32_t rA		: 3;
+	uint32_t rB		: 3;
+	uint32_t rC		: 3;
+	int32_t imm		: 11;	/* 7-bit fields sign extended except jalr's */
+};
+
+extern const std::array<struct decoded_t, DECODE_WORDS> DECODE_TABLE;
+
+/* EXT subtypes, the assembler reserves the ones not listed */
+enum EXT_TYPE {
+	EXT_NONE	= 0,	/* a plain jalr */
+	EXT_SYSCALL	= 1,	/* sys N */
+	EXT_EXCEPTION	= 7	/* exc N, halt is exc 1 */
+};
+
+enum EXC_TYPE {
+	EXC_NONE	= 0,
+	EXC_HALT	= 1,
+	EXC_TLBMISS	= 2,
+	EXC_SIGSEGV	= 3,
+	EXC_INVALID	= 4
+};
+
+/* sys N: the argument and the result are in $r1 */
+enum SYS_CALL {
+	SYS_EXIT	= 0,	/* stop with exit code $r1 */
+	SYS_PUTC	= 1,	/* write character $r1 */
+	SYS_GETC	= 2,	/* $r1 = next input character, 0xffff at the end */
+	SYS_PUTN	= 3,	/* write $r1 in decimal */
+	SYS_TIME	= 4,	/* $r1 = host milliseconds, wrapping */
+	SYS_CALLS	= 16
+};
+
+/* host side of a syscall, takes $r1 and returns the new $r1 */
+typedef std::function<uint16_t(const uint16_t arg)> sys_fn;
+
+/* why a run loop returned */
+enum STOP_REASON {
+	STOP_NONE	= 0,
+	STOP_BUDGET	= 1,
+	STOP_BREAK	= 2,
+	STOP_FAULT	= 3,	/* also exc N, see get_exc */
+	STOP_HALT	= 4,	/* halt or sys 0 */
+	STOP_IDLE	= 5,	/* spinning in a loop that can never exit */
+	STOP_WATCH	= 6,	/* the last instruction touched a watched word */
+	STOP_REASONS	= 7	/* tables indexed by reason are this long */
+};
+static_assert(STOP_REASONS == STOP_WATCH + 1, "STOP_REASONS must follow the last stop reason");
+
+/* execution cores selectable at startup */
+enum ENGINE {
+	ENG_SWITCH	= 0,
+	ENG_THREADED	= 1,
+	ENG_JIT		= 2
 };
 
 enum CTRL_CMD {
@@ -38,10 +122,29 @@ public:
 
 	enum GEN_ERR decode(const uint16_t data);
 	void draw(const uint32_t ypos, const uint32_t xpos);
+	void print(std::ostream &os);
+};
+
+/* a breakpoint condition, the source is kept for snapshots */
+struct bp_cond {
+	std::string src;
+	std::vector<uint16_t> code;
 };
 
+class jit_unit;
+class undo_unit;
+class trace_unit;
+class profile_unit;
+class timing_unit;
+struct timing_rules;
+class cache_sim;
+struct cache_config;
+
 class ctrl_unit {
 private:
+	/* specialized instruction handler, see handlers.cpp */
+	typedef void (ctrl_unit::*handler_fn)(void);
+
 	/* private members BEGIN */
 	enum CTRL_CMD command;
 	uint16_t arg_addr;
@@ -57,18 +160,63 @@ private:
 	mem_unit *mem = nullptr;
 	reg_unit *reg = nullptr;
 	instr_t instr;
+	handler_fn handler = nullptr;
+
+	std::bitset<MEM_CAPACITY> bpoints;
+	/* conditions of the breakpoints that have one */
+	std::map<uint16_t, struct bp_cond> conds;
+	uint64_t retired = 0;
+
+	/* set by EXT instructions that end a run, cleared when a run starts */
+	enum STOP_REASON trap = STOP_NONE;
+	uint16_t exit_code = 0;
+	uint8_t exc = EXC_NONE;
+	uint16_t watch_addr = 0;
+	uint8_t watch_kind = WATCH_NONE;
+	sys_fn syscalls[SYS_CALLS];
+
+	/* look for stuck loops between slices of POLL_TICKS */
+	bool idle = false;
+
+	/* predecoded instructions, filled lazily on fetch */
+	std::vector<instr_t> dcache;
+	std::vector<handler_fn> hcode;
+	std::bitset<MEM_CAPACITY> dvalid;
+
+	/* threaded core: handler label per address, tdecode when stale */
+	enum ENGINE engine = ENG_SWITCH;
+	std::vector<const void *> tcode;
+	const void *tdecode = nullptr;
+
+	/* translated ROM blocks, created on the first jit run */
+	std::unique_ptr<jit_unit> jit;
+
+	/* ROM pane row holding the drawn instruction text, -1 if none */
+	int32_t drawn_instr = -1;
+	/* ROM pane start the breakpoint column was drawn for, -1 after the
+	 * breakpoints change */
+	int32_t drawn_bpoints = -1;
 
-	std::list<uint16_t> bpoints;
+	/* reverse execution history, forces the switch core when set */
+	std::unique_ptr<undo_unit> undo;
+
+	/* binary instruction trace, also switch core only */
+	std::unique_ptr<trace_unit> trace;
+
+	/* execution counts and call tree, switch core only as well */
+	std::unique_ptr<profile_unit> profile;
+
+	/* pipeline cycle model, switch core only too */
+	std::unique_ptr<timing_unit> timing;
+
+	/* split L1 cache model, likewise */
+	std::unique_ptr<cache_sim> caches;
 	/* private members END */
 	/* private functions BEGIN */
-	void __add(void);
-	void __addi(void);
-	void __nand(void);
-	void __lui(void);
-	void __sw(void);
-	void __lw(void);
-	void __beq(void);
-	void __jalr(void);
+	template <enum RISC16 OP, bool RA, bool RB, bool RC>
+	void __op(void);
+	void __ext(void);
+	static handler_fn select(const instr_t &in);
 
 	void flush_iobuf(void);
 	enum GEN_ERR set_argaddr_from_str(const std::string str);
@@ -79,14 +227,70 @@ private:
 	void cmd_exenticks(void);
 	void cmd_addbreak(void);
 	void cmd_delbreak(void);
+	void cmd_condbreak(const std::string &cond);
+	void cmd_watch(const std::string &cmd);
+	void cmd_snapshot(const std::string &op, const std::string &path);
+	void cmd_stepback(void);
+	void cmd_runbacktobreak(void);
+	void report_trap(void);
+	bool stuck(void);
+	bool at_break(const uint16_t pc);
+
+	enum STOP_REASON run_core(const uint64_t ticks);
+	enum STOP_REASON run_threaded(const uint64_t ticks);
+	enum STOP_REASON run_jit(const uint64_t ticks);
+
+	void record_undo(void);
+	void replay_to(const uint64_t target);
+	void trace_instr(void);
+	void profile_instr(void);
+	void timing_instr(void);
+	void cache_instr(void);
+	void drop_decode(const uint16_t addr);
 	/* private functions END */
 public:
-	ctrl_unit(void) = default;
-	~ctrl_unit(void) = default;
+	ctrl_unit(void);
+	~ctrl_unit(void);
 
 	enum GEN_ERR set_mem(mem_unit *mem);
 	enum GEN_ERR set_reg(reg_unit *reg);
-	void cmd_exetobreak(void);
+	void set_engine(const enum ENGINE engine);
+	void set_syscall(const uint8_t code, const sys_fn fn);
+	void set_idle(const bool on);
+	void set_undo(const size_t depth);
+	void clear_history(void);
+	enum GEN_ERR set_trace(const char *path);
+	enum GEN_ERR save_trace(void);
+	enum GEN_ERR set_profile(const char *path);
+	enum GEN_ERR save_profile(void);
+	enum GEN_ERR set_timing(const char *path, const struct timing_rules &rules);
+	enum GEN_ERR save_timing(void);
+	enum GEN_ERR set_caches(const char *path, const struct cache_config &icfg,
+				const struct cache_config &dcfg);
+	enum GEN_ERR save_caches(void);
+	inline void invalidate(const uint16_t addr);
+	void flush_dcache(void);
+	void report_stop(const enum STOP_REASON reason);
+	enum GEN_ERR add_bpoint(const uint16_t addr);
+	enum GEN_ERR del_bpoint(const uint16_t addr);
+	enum GEN_ERR set_condition(const uint16_t addr, const std::string &cond);
+	const std::bitset<MEM_CAPACITY> &get_bpoints(void);
+	const std::map<uint16_t, struct bp_cond> &get_conds(void);
+	void set_bpoints(const std::bitset<MEM_CAPACITY> &bpoints, const std::map<uint16_t, struct bp_cond> &conds);
+	void hit_watch(const uint16_t addr, const uint8_t kind);
+	enum GEN_ERR save_snapshot(const char *path);
+	enum GEN_ERR load_snapshot(const char *path);
+	enum STOP_REASON run(const uint64_t ticks);
+	enum STOP_REASON resume(const uint64_t ticks);
+	enum GEN_ERR step(void);
+	enum GEN_ERR step_back(const uint64_t n);
+	enum GEN_ERR run_back_to_break(void);
+	uint64_t get_retired(void);
+	uint64_t get_cycles(void);
+	uint16_t get_exit_code(void);
+	uint8_t get_exc(void);
+	uint16_t get_watch_addr(void);
+	uint8_t get_watch_kind(void);
 
 	enum GEN_ERR fetch(void);
 	enum GEN_ERR decode(void);
@@ -95,5 +299,21 @@ public:
 	enum GEN_ERR getline(void);
 	enum GEN_ERR parseio(void);
 
+	void touch(void);
 	void draw(void);
 };
+
+/* called on every store: kept in the header so it inlines, only words
+ * that were decoded and translated ROM need any work */
+inline void ctrl_unit::invalidate(const uint16_t addr)
+{
+	if (this->dvalid.test(addr) || (addr <= ROM_END && this->jit))
+		this->drop_decode(addr);
+}
+
+enum GEN_ERR str2engine(const char *str, enum ENGINE &engine);
+enum GEN_ERR str2num(const char *str, const int base, const uint64_t max, uint64_t &num);
+const char *stop2str(const enum STOP_REASON reason);
+std::string disasm_at(mem_unit *mem, const uint16_t addr);
+
+#endif
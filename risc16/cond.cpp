@@ -0,0 +1,298 @@
+#include "cond.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+/* recursive descent over
+ *
+ *	or	:= and { "||" and }
+ *	and	:= cmp { "&&" cmp }
+ *	cmp	:= sum [ ("==" | "!=" | "<" | "<=" | ">" | ">=") sum ]
+ *	sum	:= unary { ("+" | "-" | "&" | "|") unary }
+ *	unary	:= ("!" | "-") unary | primary
+ *	primary	:= number | reg | "pc" | label | "[" or "]" | "(" or ")"
+ *
+ * emitting postfix code while tracking how deep the operand stack gets */
+class cond_parser {
+private:
+	/* private members BEGIN */
+	const std::string &src;
+	const std::map<uint16_t, std::string> &symbols;
+	std::vector<uint16_t> &code;
+	size_t pos = 0;
+	uint32_t depth = 0;
+	bool ok = true;
+	/* private members END */
+	/* private functions BEGIN */
+	void skip(void)
+	{
+		while (this->pos < this->src.size() && isspace(this->src[this->pos]))
+			this->pos++;
+	}
+
+	bool accept(const char *tok)
+	{
+		this->skip();
+		const size_t len = strlen(tok);
+		if (this->src.compare(this->pos, len, tok) != 0)
+			return false;
+		/* "<" must not take the first half of "<=", "|" of "||" and so on */
+		const char next = (this->pos + 1 < this->src.size()) ? this->src[this->pos + 1] : 0;
+		if (len == 1 && strchr("<>!", tok[0]) && next == '=')
+			return false;
+		if (len == 1 && strchr("&|", tok[0]) && next == tok[0])
+			return false;
+		this->pos += len;
+		return true;
+	}
+
+	void push(const uint16_t op)
+	{
+		this->code.push_back(op);
+		if (op == COND_IMM || op == COND_REG || op == COND_PC) {
+			if (++this->depth > COND_STACK)
+				this->ok = false;
+		} else if (op != COND_LOAD && op != COND_NOT) {
+			this->depth--;
+		}
+	}
+
+	void push(const uint16_t op, const uint16_t arg)
+	{
+		this->push(op);
+		this->code.push_back(arg);
+	}
+
+	void primary(void)
+	{
+		this->skip();
+		if (this->accept("[")) {
+			this->parse_or();
+			this->push(COND_LOAD);
+			this->ok &= this->accept("]");
+			return;
+		}
+		if (this->accept("(")) {
+			this->parse_or();
+			this->ok &= this->accept(")");
+			return;
+		}
+
+		const char *start = this->src.c_str() + this->pos;
+		if (isdigit(*start)) {
+			char *end = nullptr;
+			const unsigned long val = strtoul(start, &end, 0);
+			this->ok &= (val <= UINT16_MAX);
+			this->pos += end - start;
+			this->push(COND_IMM, val);
+			return;
+		}
+
+		size_t len = 0;
+		while (isalnum(start[len]) || start[len] == '_' || start[len] == '$')
+			len++;
+		const std::string name(start, len);
+		this->pos += len;
+		if (name == "pc" || name == "$pc") {
+			this->push(COND_PC);
+			return;
+		}
+		const size_t skip = (name[0] == '$') ? 1 : 0;
+		if (name.size() == 2 + skip && name[skip] == 'r' && name[skip + 1] >= '0' && name[skip + 1] < '0' + N_OF_REGS) {
+			this->push(COND_REG, name[skip + 1] - '0');
+			return;
+		}
+		for (auto const& it : this->symbols) {
+			if (it.second == name) {
+				this->push(COND_IMM, it.first);
+				return;
+			}
+		}
+		this->ok = false;
+	}
+
+	void unary(void)
+	{
+		if (this->accept("!")) {
+			this->unary();
+			this->push(COND_NOT);
+		} else if (this->accept("-")) {
+			this->push(COND_IMM, 0);
+			this->unary();
+			this->push(COND_SUB);
+		} else {
+			this->primary();
+		}
+	}
+
+	void sum(void)
+	{
+		enum COND_OP op;
+		this->unary();
+		while (this->ok) {
+			if (this->accept("+"))
+				op = COND_ADD;
+			else if (this->accept("-"))
+				op = COND_SUB;
+			else if (this->accept("&"))
+				op = COND_BAND;
+			else if (this->accept("|"))
+				op = COND_BOR;
+			else
+				break;
+			this->unary();
+			this->push(op);
+		}
+	}
+
+	void cmp(void)
+	{
+		static const struct { const char *tok; enum COND_OP op; } CMPS[] = {
+			{ "==", COND_EQ }, { "!=", COND_NE }, { "<=", COND_LE },
+			{ ">=", COND_GE }, { "<", COND_LT }, { ">", COND_GT }
+		};
+		this->sum();
+		for (auto const& it : CMPS) {
+			if (this->accept(it.tok)) {
+				this->sum();
+				this->push(it.op);
+				return;
+			}
+		}
+	}
+
+	void parse_and(void)
+	{
+		this->cmp();
+		while (this->ok && this->accept("&&")) {
+			this->cmp();
+			this->push(COND_AND);
+		}
+	}
+
+	void parse_or(void)
+	{
+		this->parse_and();
+		while (this->ok && this->accept("||")) {
+			this->parse_and();
+			this->push(COND_OR);
+		}
+	}
+	/* private functions END */
+public:
+	cond_parser(const std::string &src, const std::map<uint16_t, std::string> &symbols,
+		    std::vector<uint16_t> &code) : src(src), symbols(symbols), code(code) {}
+
+	enum GEN_ERR parse(void)
+	{
+		this->code.clear();
+		this->parse_or();
+		this->skip();
+		if (!this->ok || this->pos != this->src.size() || this->depth != 1)
+			return E_ARG;
+		return E_OK;
+	}
+};
+
+enum GEN_ERR cond_compile(const std::string &src, const std::map<uint16_t, std::string> &symbols,
+			  std::vector<uint16_t> &code)
+{
+	return cond_parser(src, symbols, code).parse();
+}
+
+/* load reads one word, the two cond_eval flavours differ only there */
+template <typename load_fn>
+static bool eval(const std::vector<uint16_t> &code, const uint16_t *rx, const uint16_t pc, load_fn load)
+{
+	uint16_t stack[COND_STACK];
+	uint32_t sp = 0;
+	uint16_t a, b;
+
+	for (size_t i = 0; i < code.size(); i++) {
+		switch (code[i]) {
+		case COND_IMM:
+			stack[sp++] = code[++i];
+			continue;
+		case COND_REG:
+			stack[sp++] = rx[code[++i]];
+			continue;
+		case COND_PC:
+			stack[sp++] = pc;
+			continue;
+		case COND_LOAD:
+			stack[sp - 1] = load(stack[sp - 1]);
+			continue;
+		case COND_NOT:
+			stack[sp - 1] = !stack[sp - 1];
+			continue;
+
+		default:
+			break;
+		};
+
+		b = stack[--sp];
+		a = stack[sp - 1];
+		switch (code[i]) {
+		case COND_ADD:
+			a = a + b;
+			break;
+		case COND_SUB:
+			a = a - b;
+			break;
+		case COND_BAND:
+			a = a & b;
+			break;
+		case COND_BOR:
+			a = a | b;
+			break;
+		case COND_EQ:
+			a = (a == b);
+			break;
+		case COND_NE:
+			a = (a != b);
+			break;
+		case COND_LT:
+			a = (a < b);
+			break;
+		case COND_LE:
+			a = (a <= b);
+			break;
+		case COND_GT:
+			a = (a > b);
+			break;
+		case COND_GE:
+			a = (a >= b);
+			break;
+		case COND_AND:
+			a = (a && b);
+			break;
+		case COND_OR:
+			a = (a || b);
+			break;
+		};
+		stack[sp - 1] = a;
+	}
+	return stack[0];
+}
+
+/* runs on the live register file, loads skip devices and watchpoints */
+bool cond_eval(const std::vector<uint16_t> &code, const uint16_t *rx, const uint16_t pc, mem_unit *mem)
+{
+	return eval(code, rx, pc, [mem](const uint16_t addr) {
+		uint16_t word;
+		mem->read_block(addr, &word, 1);
+		return word;
+	});
+}
+
+/* for memory that isn't a mem_unit, word addr sits at mem[addr * stride] */
+bool cond_eval(const std::vector<uint16_t> &code, const uint16_t *rx, const uint16_t pc,
+	       const uint16_t *mem, const uint32_t stride)
+{
+	return eval(code, rx, pc, [mem, stride](const uint16_t addr) {
+		return mem[addr * stride];
+	});
+}
@@ -0,0 +1,44 @@
+#ifndef COND_H
+#define COND_H
+
+#include "modules.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#define COND_STACK	16	/* deepest operand stack a condition may need */
+
+/* breakpoint condition bytecode, a postfix program over 16-bit words.
+ * COND_IMM and COND_REG take the next word as their operand, everything
+ * else works on the operand stack */
+enum COND_OP {
+	COND_IMM	= 0,
+	COND_REG	= 1,
+	COND_PC		= 2,
+	COND_LOAD	= 3,	/* replaces an address with the word there */
+	COND_NOT	= 4,
+	COND_ADD	= 5,
+	COND_SUB	= 6,
+	COND_BAND	= 7,
+	COND_BOR	= 8,
+	COND_EQ		= 9,
+	COND_NE		= 10,
+	COND_LT		= 11,
+	COND_LE		= 12,
+	COND_GT		= 13,
+	COND_GE		= 14,
+	COND_AND	= 15,
+	COND_OR		= 16
+};
+
+/* compiles e.g. "r2 == 0 && [0x3000] > 5", comparisons are unsigned.
+ * operands are numbers, r0-r7, pc, labels and [address] loads */
+enum GEN_ERR cond_compile(const std::string &src, const std::map<uint16_t, std::string> &symbols,
+			  std::vector<uint16_t> &code);
+bool cond_eval(const std::vector<uint16_t> &code, const uint16_t *rx, const uint16_t pc, mem_unit *mem);
+bool cond_eval(const std::vector<uint16_t> &code, const uint16_t *rx, const uint16_t pc,
+	       const uint16_t *mem, const uint32_t stride);
+
+#endif
@@ -0,0 +1,150 @@
+#include "console.h"
+#include "winpos.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <cctype>
+#include <algorithm>
+#include <thread>
+#include <ncurses.h>
+
+static void rectangle(uint32_t y1, uint32_t x1, uint32_t y2, uint32_t x2)
+{
+	mvhline(y1, x1, ACS_HLINE, x2 - x1);
+	mvhline(y2, x1, ACS_HLINE, x2 - x1);
+	mvvline(y1, x1, ACS_VLINE, y2 - y1);
+	mvvline(y1, x2, ACS_VLINE, y2 - y1);
+	mvaddch(y1, x1, ACS_ULCORNER);
+	mvaddch(y2, x1, ACS_LLCORNER);
+	mvaddch(y1, x2, ACS_URCORNER);
+	mvaddch(y2, x2, ACS_LRCORNER);
+}
+
+console_unit::console_unit(void)
+{
+	this->rows.push_back(std::string());
+}
+
+/* host terminals get a final newline so later output starts on its own line */
+void console_unit::flush(void)
+{
+	if (this->sink == SINK_STDOUT) {
+		if (this->last != '\n')
+			std::cout << '\n';
+		this->last = '\n';
+		std::cout.flush();
+	} else if (this->sink == SINK_FILE) {
+		this->file.flush();
+	}
+}
+
+enum GEN_ERR console_unit::open(const enum SINK sink, const char *path)
+{
+	this->sink = sink;
+	if (sink == SINK_FILE) {
+		this->file.open(path, std::ios::binary | std::ios::trunc);
+		if (!this->file.is_open())
+			return E_IO;
+	}
+	return E_OK;
+}
+
+enum GEN_ERR console_unit::attach(mem_unit *mem)
+{
+	return mem->map_device(STDOUT_START, STDOUT_END, nullptr,
+			       [this](const uint16_t addr, const uint16_t data) { this->put(data); });
+}
+
+void console_unit::newline(void)
+{
+	if (this->rows.size() == STDOUT_H) {
+		this->rows.erase(this->rows.begin());
+		this->first_dirty = 0;
+	}
+	this->rows.push_back(std::string());
+}
+
+void console_unit::put(const uint16_t data)
+{
+	const char c = data & 0xff;
+	this->last = c;
+	if (this->sink == SINK_STDOUT) {
+		std::cout.put(c);
+		return;
+	}
+	if (this->sink == SINK_FILE) {
+		this->file.put(c);
+		return;
+	}
+	if (this->async) {
+		/* only a full ring waits, for the render thread to drain it */
+		while (!this->queue->push(c))
+			std::this_thread::yield();
+		return;
+	}
+	this->show(c);
+}
+
+void console_unit::show(const char c)
+{
+	if (c == '\n') {
+		this->newline();
+	} else if (isprint(c)) {
+		if (this->rows.back().size() == STDOUT_W)
+			this->newline();
+		this->first_dirty = std::min(this->first_dirty, this->rows.size() - 1);
+		this->rows.back().push_back(c);
+	}
+}
+
+/* while on, put may run on another thread than draw */
+void console_unit::set_async(const bool on)
+{
+	if (on && !this->queue)
+		this->queue = std::make_unique<spsc_queue<char, CONSOLE_QUEUE>>();
+
+	if (!on)
+		this->drain();
+	this->async = on;
+}
+
+/* moves what an emulation thread put into the pane, returns how much */
+size_t console_unit::drain(void)
+{
+	size_t n = 0;
+	char c;
+	while (this->queue && this->queue->pop(c)) {
+		this->show(c);
+		n++;
+	}
+	return n;
+}
+
+/* forces the next draw to repaint everything, e.g. after clear() */
+void console_unit::touch(void)
+{
+	this->redraw = true;
+	this->first_dirty = 0;
+}
+
+void console_unit::draw(void)
+{
+	if (this->sink != SINK_PANE)
+		return;
+
+	this->drain();
+	if (this->redraw) {
+		attron(A_BOLD);
+		rectangle(Y_STDOUT - 1, X_STDOUT - 1, Y_STDOUT + STDOUT_H,
+			  X_STDOUT + STDOUT_W);
+		attroff(A_BOLD);
+	}
+	/* a scroll moves every row, plain output only touches the last ones */
+	for (size_t i = this->first_dirty; i < STDOUT_H; i++) {
+		const char *text = (i < this->rows.size()) ? this->rows[i].c_str() : "";
+		mvprintw(Y_STDOUT + i, X_STDOUT, "%-*s", STDOUT_W, text);
+	}
+
+	this->first_dirty = STDOUT_H;
+	this->redraw = false;
+}
@@ -0,0 +1,59 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "modules.h"
+#include "spsc.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define CONSOLE_QUEUE	4096	/* characters in flight to the render thread */
+
+/* where characters stored to STDOUT_START..STDOUT_END end up */
+enum SINK {
+	SINK_PANE	= 0,	/* the ncurses stdout box */
+	SINK_FILE	= 1,
+	SINK_STDOUT	= 2	/* the host's stdout, for headless runs */
+};
+
+/* stdout device: every store is one character, pushed straight to a sink
+ * instead of the UI rescanning the whole region each frame */
+class console_unit {
+private:
+	/* private members BEGIN */
+	enum SINK sink = SINK_PANE;
+	std::ofstream file;
+	char last = '\n';
+
+	/* pane contents, the last row is the one being written */
+	std::vector<std::string> rows;
+	size_t first_dirty = 0;	/* STDOUT_H when nothing changed */
+	bool redraw = true;
+
+	/* pane output of an emulation thread, drained by the render thread */
+	bool async = false;
+	std::unique_ptr<spsc_queue<char, CONSOLE_QUEUE>> queue;
+	/* private members END */
+	/* private functions BEGIN */
+	void newline(void);
+	void show(const char c);
+	/* private functions END */
+public:
+	console_unit(void);
+	~console_unit(void) = default;
+
+	enum GEN_ERR open(const enum SINK sink, const char *path);
+	enum GEN_ERR attach(mem_unit *mem);
+	void put(const uint16_t data);
+	void set_async(const bool on);
+	size_t drain(void);
+	void flush(void);
+
+	void touch(void);
+	void draw(void);
+};
+
+#endif
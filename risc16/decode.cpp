@@ -0,0 +1,180 @@
+#include "cmdi.h"
+
+#include <cstdint>
+#include <array>
+
+/* instruction decode table
+ *
+ * every one of the 65536 words is decoded while compiling, so decoding at
+ * run time is a single indexed load. the table is generated from the field
+ * layout of each opcode and checked word for word against the branching
+ * decoder it replaced, and by encoding every entry back. the 7-bit
+ * immediates of addi, lw, sw and beq are sign extended so the engines can
+ * add them modulo 2^16, jalr keeps its field as is for the EXT subtype */
+
+enum FORMAT {
+	FMT_RRR,	/* add, nand */
+	FMT_RRI,	/* addi, sw, lw, beq, jalr */
+	FMT_RI		/* lui */
+};
+
+static constexpr enum FORMAT FORMATS[8] = {
+	FMT_RRR, FMT_RRI, FMT_RRR, FMT_RI,
+	FMT_RRI, FMT_RRI, FMT_RRI, FMT_RRI
+};
+
+static constexpr struct decoded_t build(const uint16_t data)
+{
+	struct decoded_t dec = {};
+	const uint8_t op = (data & MASK_OP) >> 13;
+
+	dec.handler = dec.opcode = op;
+	dec.rA = (data & MASK_RA) >> 10;
+	switch (FORMATS[op]) {
+	case FMT_RRR:
+		dec.rB = (data & MASK_RB) >> 7;
+		dec.rC = data & MASK_RC;
+		break;
+	case FMT_RRI:
+		dec.rB = (data & MASK_RB) >> 7;
+		dec.imm = (op == __JALR) ? data & MASK_IM7 : ((data & MASK_IM7) ^ 0x40) - 0x40;
+		break;
+	case FMT_RI:
+		dec.imm = data & MASK_IM10;
+		break;
+	};
+
+	/* jalr $r0, $r0 with a subtype is EXT, the reserved subtypes fault */
+	if (op == __JALR && !dec.rA && !dec.rB && (dec.imm >> 4) != EXT_NONE) {
+		if ((dec.imm >> 4) == EXT_SYSCALL || (dec.imm >> 4) == EXT_EXCEPTION)
+			dec.handler = dec.opcode = __EXT;
+		else
+			dec.handler = DEC_INVALID;
+	}
+	return dec;
+}
+
+static constexpr std::array<struct decoded_t, DECODE_WORDS> generate(void)
+{
+	std::array<struct decoded_t, DECODE_WORDS> table = {};
+	for (uint32_t data = 0; data < DECODE_WORDS; data++)
+		table[data] = build(data);
+	return table;
+}
+
+extern constexpr std::array<struct decoded_t, DECODE_WORDS> DECODE_TABLE = generate();
+
+/* the old instr_t::decode, kept only to check the table against */
+static constexpr struct decoded_t reference(const uint16_t data)
+{
+	bool valid = true;
+	uint8_t rA = 0;
+	uint8_t rB = 0;
+	uint8_t rC = 0;
+	uint16_t imm = 0;
+	enum RISC16 opcode = static_cast<enum RISC16>((data & MASK_OP) >> 13);
+
+	switch (opcode) {
+	case __ADD:
+	case __NAND:
+		rA = (data & MASK_RA) >> 10;
+		rB = (data & MASK_RB) >> 7;
+		rC = data & MASK_RC;
+		break;
+	case __ADDI:
+	case __SW:
+	case __LW:
+	case __BEQ:
+	case __JALR:
+		rA = (data & MASK_RA) >> 10;
+		rB = (data & MASK_RB) >> 7;
+		imm = data & MASK_IM7;
+		break;
+	case __LUI:
+		rA = (data & MASK_RA) >> 10;
+		imm = data & MASK_IM10;
+		break;
+
+	default:
+		valid = false;
+		break;
+	};
+
+	if (opcode == __JALR && !rA && !rB && (imm >> 4) != EXT_NONE) {
+		if ((imm >> 4) == EXT_SYSCALL || (imm >> 4) == EXT_EXCEPTION)
+			opcode = __EXT;
+		else
+			valid = false;
+	}
+
+	struct decoded_t dec = {};
+	dec.handler = valid ? opcode : DEC_INVALID;
+	dec.opcode = opcode;
+	dec.rA = rA;
+	dec.rB = rB;
+	dec.rC = rC;
+	/* the one intended difference: bit 6 is the sign of a 7-bit field */
+	const bool sign = (opcode == __ADDI || opcode == __SW || opcode == __LW || opcode == __BEQ) &&
+			  (imm & 0x40);
+	dec.imm = sign ? imm - 0x80 : imm;
+	return dec;
+}
+
+/* the second check runs the other way round: the fields of every entry
+ * are put back together the way the assembler lays them out and have to
+ * give the word again, minus the bits the format ignores */
+static constexpr uint16_t encode(const struct decoded_t &dec)
+{
+	const uint8_t op = (dec.opcode == __EXT) ? __JALR : dec.opcode;
+	uint16_t data = op << 13 | dec.rA << 10;
+	if (op == __LUI)
+		return data | dec.imm;
+	data |= dec.rB << 7;
+	if (op == __ADD || op == __NAND)
+		return data | dec.rC;
+	return data | (dec.imm & MASK_IM7);
+}
+
+static constexpr bool verify(void)
+{
+	for (uint32_t data = 0; data < DECODE_WORDS; data++) {
+		const struct decoded_t dec = DECODE_TABLE[data];
+		const struct decoded_t ref = reference(data);
+		if (dec.handler != ref.handler || dec.opcode != ref.opcode || dec.rA != ref.rA ||
+		    dec.rB != ref.rB || dec.rC != ref.rC || dec.imm != ref.imm)
+			return false;
+
+		const uint8_t op = data >> 13;
+		/* add and nand leave bits 3-6 unused */
+		const uint16_t used = (op == __ADD || op == __NAND) ? 0xff87 : 0xffff;
+		if (encode(dec) != (data & used))
+			return false;
+
+		/* jalr $r0, $r0, imm: sys for subtype 1, exc for 7, reserved
+		 * otherwise, a plain jump for subtype 0 */
+		const bool jalr00 = op == __JALR && !(data & (MASK_RA | MASK_RB));
+		const uint8_t sub = (data & MASK_IM7) >> 4;
+		const bool ext = jalr00 && (sub == EXT_SYSCALL || sub == EXT_EXCEPTION);
+		const bool reserved = jalr00 && sub != EXT_NONE && !ext;
+		if ((dec.opcode == __EXT) != ext || (dec.handler == DEC_INVALID) != reserved)
+			return false;
+		if (dec.handler != DEC_INVALID && dec.handler != dec.opcode)
+			return false;
+	}
+	return true;
+}
+
+static_assert(sizeof(struct decoded_t) == 4, "decoded_t must stay packed");
+static_assert(verify(), "decode table differs from the reference decoder or its words");
+/* spot checks against words the assembler emits */
+static_assert(DECODE_TABLE[0xe012].opcode == __EXT && DECODE_TABLE[0xe012].imm == (EXT_SYSCALL << 4 | SYS_GETC),
+	      "sys 2 must decode as EXT");
+static_assert(DECODE_TABLE[0xe071].opcode == __EXT && DECODE_TABLE[0xe071].imm == (EXT_EXCEPTION << 4 | EXC_HALT),
+	      "halt must decode as EXT");
+static_assert(DECODE_TABLE[0x2901].opcode == __ADDI && DECODE_TABLE[0x2901].rA == 2 &&
+	      DECODE_TABLE[0x2901].rB == 2 && DECODE_TABLE[0x2901].imm == 1, "addi r2, r2, 1");
+static_assert(DECODE_TABLE[0xc07c].opcode == __BEQ && DECODE_TABLE[0xc07c].imm == -4,
+	      "beq displacements are signed");
+static_assert(DECODE_TABLE[0x24ff].opcode == __ADDI && DECODE_TABLE[0x24ff].imm == -1, "addi r1, r1, -1");
+static_assert(DECODE_TABLE[0xe05f].opcode == __JALR && DECODE_TABLE[0xe05f].handler == DEC_INVALID &&
+	      DECODE_TABLE[0xe05f].imm == 0x5f, "jalr fields stay unsigned for the EXT subtype");
@@ -0,0 +1,220 @@
+#include "diff.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+static const char *ENGINES[3] = { "switch", "threaded", "jit" };
+
+diff_unit::diff_unit(const struct diff_opts &opts)
+{
+	this->opts = opts;
+	this->image.assign(MEM_CAPACITY, 0);
+
+	for (uint8_t i = 0; i < 2; i++) {
+		this->sides[i] = std::make_unique<diff_side>();
+		struct diff_side *side = this->sides[i].get();
+		side->mem.reset();
+		side->mem.set_track(true);
+		side->reg.reset();
+		side->ctrl.set_mem(&side->mem);
+		side->ctrl.set_reg(&side->reg);
+		side->ctrl.set_engine(opts.engines[i]);
+	}
+}
+
+void diff_unit::load(const uint16_t *image, const uint16_t pc, const uint16_t *rx)
+{
+	std::copy_n(image, MEM_CAPACITY, this->image.begin());
+	this->pc = pc;
+	std::copy_n(rx, N_OF_REGS, this->rx);
+}
+
+/* both machines back to the loaded state, translations dropped */
+void diff_unit::reset(void)
+{
+	for (auto const& side : this->sides) {
+		side->mem.write_block(0, this->image.data(), MEM_CAPACITY);
+		side->reg.reset();
+		side->reg.set_pc(this->pc);
+		for (uint16_t i = 1; i < N_OF_REGS; i++)
+			side->reg.write(i, this->rx[i]);
+		side->pages.reset();
+		side->reason = STOP_NONE;
+		side->done = 0;
+	}
+}
+
+void diff_unit::step(const uint64_t ticks)
+{
+	for (auto const& side : this->sides) {
+		const uint64_t before = side->ctrl.get_retired();
+		side->pages.reset();
+		side->reason = side->ctrl.run(ticks);
+		side->done += side->ctrl.get_retired() - before;
+		side->mem.take_dirty(side->pages);
+	}
+}
+
+bool diff_unit::same(void)
+{
+	struct diff_side &a = *this->sides[0];
+	struct diff_side &b = *this->sides[1];
+	if (a.reason != b.reason || a.done != b.done || a.reg.get_pc() != b.reg.get_pc())
+		return false;
+	for (uint16_t i = 1; i < N_OF_REGS; i++) {
+		if (a.reg.read(i) != b.reg.read(i))
+			return false;
+	}
+	return this->same_ram(nullptr);
+}
+
+/* compares the pages either side stored to, collecting the words that
+ * differ into differ or stopping at the first one */
+bool diff_unit::same_ram(std::vector<uint16_t> *differ)
+{
+	const std::bitset<BUS_PAGES> pages = this->sides[0]->pages | this->sides[1]->pages;
+	uint16_t a[1 << BUS_PAGE_SHIFT], b[1 << BUS_PAGE_SHIFT];
+	bool same = true;
+	for (uint32_t page = 0; page < BUS_PAGES; page++) {
+		if (!pages.test(page))
+			continue;
+		const uint16_t start = page << BUS_PAGE_SHIFT;
+		this->sides[0]->mem.read_block(start, a, 1 << BUS_PAGE_SHIFT);
+		this->sides[1]->mem.read_block(start, b, 1 << BUS_PAGE_SHIFT);
+		for (uint32_t i = 0; i < (1 << BUS_PAGE_SHIFT); i++) {
+			if (a[i] == b[i])
+				continue;
+			if (!differ)
+				return false;
+			differ->push_back(start + i);
+			same = false;
+		}
+	}
+	return same;
+}
+
+void diff_unit::print(std::ostream &os, const uint8_t side, const std::vector<uint16_t> &differ)
+{
+	struct diff_side &at = *this->sides[side];
+	char buf[64];
+	snprintf(buf, sizeof(buf), "  %-8s %s, %llu retired, $pc 0x%04x,", ENGINES[this->opts.engines[side]],
+		 stop2str(at.reason), static_cast<unsigned long long>(at.done), at.reg.get_pc());
+	os << buf;
+	for (uint16_t i = 1; i < N_OF_REGS; i++) {
+		snprintf(buf, sizeof(buf), " $r%u 0x%04x", i, at.reg.read(i));
+		os << buf;
+	}
+	for (auto const& addr : differ) {
+		uint16_t word;
+		at.mem.read_block(addr, &word, 1);
+		snprintf(buf, sizeof(buf), " [0x%04x]=0x%04x", addr, word);
+		os << buf;
+	}
+	os << "\n";
+}
+
+/* replays up to the block that went wrong and single steps through it */
+void diff_unit::locate(const uint64_t start, std::ostream &os)
+{
+	char buf[64];
+	instr_t instr;
+
+	this->reset();
+	while (this->sides[0]->done < start)
+		this->step(std::min<uint64_t>(DIFF_BLOCK, start - this->sides[0]->done));
+
+	for (uint32_t i = 0; i < DIFF_BLOCK; i++) {
+		const uint16_t pc = this->sides[0]->reg.get_pc();
+		uint16_t word;
+		this->sides[0]->mem.read_block(pc, &word, 1);
+		this->step(1);
+		if (!this->same()) {
+			instr.decode(word);
+			snprintf(buf, sizeof(buf), "diverged at instruction %llu, 0x%04x: 0x%04x  ",
+				 static_cast<unsigned long long>(start + i), pc, word);
+			os << buf;
+			instr.print(os);
+			os << "\n";
+			std::vector<uint16_t> differ;
+			this->same_ram(&differ);
+			this->print(os, 0, differ);
+			this->print(os, 1, differ);
+			return;
+		}
+		if (this->sides[0]->reason != STOP_BUDGET)
+			break;
+	}
+
+	/* only shows up when whole blocks run, e.g. inside translated code */
+	snprintf(buf, sizeof(buf), "diverged in instructions %llu-%llu, not when single stepped\n",
+		 static_cast<unsigned long long>(start), static_cast<unsigned long long>(start + DIFF_BLOCK - 1));
+	os << buf;
+	this->reset();
+	while (this->sides[0]->done < start)
+		this->step(std::min<uint64_t>(DIFF_BLOCK, start - this->sides[0]->done));
+	this->step(DIFF_BLOCK);
+	std::vector<uint16_t> differ;
+	this->same_ram(&differ);
+	this->print(os, 0, differ);
+	this->print(os, 1, differ);
+}
+
+/* E_RANGE and a report on os at the first difference */
+enum GEN_ERR diff_unit::run(std::ostream &os)
+{
+	this->reset();
+	uint64_t start = 0;
+	while (this->sides[0]->done < this->opts.budget) {
+		this->step(std::min<uint64_t>(DIFF_BLOCK, this->opts.budget - this->sides[0]->done));
+		if (!this->same()) {
+			this->locate(start, os);
+			return E_RANGE;
+		}
+		if (this->sides[0]->reason != STOP_BUDGET)
+			break;
+		start = this->sides[0]->done;
+	}
+	return E_OK;
+}
+
+uint64_t diff_unit::get_retired(void)
+{
+	return this->sides[0]->done;
+}
+
+/* random ROM words and registers, one program per seed */
+enum GEN_ERR diff_fuzz(const struct diff_opts &opts, const uint32_t programs,
+		       const uint32_t seed, std::ostream &os)
+{
+	diff_unit diff(opts);
+	std::vector<uint16_t> image(MEM_CAPACITY, 0);
+	uint16_t rx[N_OF_REGS] = { 0 };
+	uint64_t total = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < programs; i++) {
+		std::mt19937 rng(seed + i);
+		for (uint32_t addr = 0; addr < FUZZ_WORDS; addr++)
+			image[addr] = rng();
+		for (uint16_t reg = 1; reg < N_OF_REGS; reg++)
+			rx[reg] = rng();
+
+		diff.load(image.data(), 0, rx);
+		if (diff.run(os) != E_OK) {
+			os << "reproduce with --fuzz 1 --seed " << seed + i << "\n";
+			return E_RANGE;
+		}
+		total += diff.get_retired();
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	const double secs = std::chrono::duration<double>(end - start).count();
+	os << "programs: " << programs << "\n";
+	os << "retired: " << total << "\n";
+	os << "time: " << secs << " s\n";
+	return E_OK;
+}
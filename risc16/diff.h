@@ -0,0 +1,65 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include "modules.h"
+#include "cmdi.h"
+
+#include <cstdint>
+#include <bitset>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#define DIFF_BLOCK	64	/* instructions between comparisons */
+#define FUZZ_WORDS	256	/* random ROM words per fuzzed program */
+#define FUZZ_BUDGET	4096	/* default instructions per fuzzed program */
+
+struct diff_opts {
+	enum ENGINE engines[2] = { ENG_SWITCH, ENG_JIT };
+	uint64_t budget = UINT64_MAX;
+};
+
+/* one machine on plain RAM pages, so every engine keeps its fast paths */
+struct diff_side {
+	mem_unit mem;
+	reg_unit reg;
+	ctrl_unit ctrl;
+	std::bitset<BUS_PAGES> pages;	/* stored to during the last block */
+	enum STOP_REASON reason = STOP_NONE;
+	uint64_t done = 0;
+};
+
+/* runs the same machine on two engines DIFF_BLOCK instructions at a time
+ * and compares stop reasons, retired counts, registers and the RAM pages
+ * either side stored to in every block */
+class diff_unit {
+private:
+	/* private members BEGIN */
+	struct diff_opts opts;
+	std::unique_ptr<struct diff_side> sides[2];
+
+	std::vector<uint16_t> image;
+	uint16_t pc = 0;
+	uint16_t rx[N_OF_REGS] = { 0 };
+	/* private members END */
+	/* private functions BEGIN */
+	void reset(void);
+	void step(const uint64_t ticks);
+	bool same(void);
+	bool same_ram(std::vector<uint16_t> *differ);
+	void locate(const uint64_t start, std::ostream &os);
+	void print(std::ostream &os, const uint8_t side, const std::vector<uint16_t> &differ);
+	/* private functions END */
+public:
+	diff_unit(const struct diff_opts &opts);
+	~diff_unit(void) = default;
+
+	void load(const uint16_t *image, const uint16_t pc, const uint16_t *rx);
+	enum GEN_ERR run(std::ostream &os);
+	uint64_t get_retired(void);
+};
+
+enum GEN_ERR diff_fuzz(const struct diff_opts &opts, const uint32_t programs,
+		       const uint32_t seed, std::ostream &os);
+
+#endif
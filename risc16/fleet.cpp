@@ -0,0 +1,213 @@
+#include "fleet.h"
+#include "pool.h"
+#include "lockstep.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <memory>
+#include <algorithm>
+
+fleet_unit::fleet_unit(mem_unit *mem, reg_unit *reg, const struct fleet_opts &opts)
+{
+	this->opts = opts;
+	this->image.resize(MEM_CAPACITY);
+	mem->read_block(0, this->image.data(), MEM_CAPACITY);
+	this->pc = reg->get_pc();
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		this->rx[i] = reg->read(i);
+}
+
+/* blank lines are cases without pokes, '#' starts a comment and lines
+ * holding nothing else are skipped */
+enum GEN_ERR fleet_unit::load_cases(const char *path)
+{
+	enum GEN_ERR retval = E_OK;
+
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		retval = E_IO;
+		std::cerr << "ERR " << retval << ": file \"" << path << "\" not found\n";
+		return retval;
+	}
+
+	std::string line;
+	uint32_t lineno = 0;
+	while (std::getline(file, line)) {
+		lineno++;
+		const size_t hash = line.find('#');
+		if (hash != std::string::npos) {
+			line.erase(hash);
+			if (line.find_first_not_of(" \t\r") == std::string::npos)
+				continue;
+		}
+
+		struct fleet_case fcase;
+		std::istringstream tokens(line);
+		std::string token;
+		while (tokens >> token) {
+			const size_t eq = token.find('=');
+			uint64_t addr, data;
+			if (eq == std::string::npos ||
+			    str2num(token.substr(0, eq).c_str(), 16, UINT16_MAX, addr) != E_OK ||
+			    str2num(token.substr(eq + 1).c_str(), 16, UINT16_MAX, data) != E_OK) {
+				retval = E_ARG;
+				std::cerr << "ERR " << retval << ": bad poke {" << token << "} at line " << lineno << "\n";
+				return retval;
+			}
+			fcase.pokes.push_back({ addr, data });
+		}
+		this->cases.push_back(fcase);
+	}
+	return retval;
+}
+
+void fleet_unit::run_case(const size_t id)
+{
+	mem_unit memory = mem_unit();
+	memory.reset();
+	memory.write_block(0, this->image.data(), MEM_CAPACITY);
+	for (auto const& poke : this->cases[id].pokes)
+		memory.write(poke.first, poke.second, true);
+
+	reg_unit registers = reg_unit();
+	registers.reset();
+	registers.set_pc(this->pc);
+	for (uint16_t i = 1; i < N_OF_REGS; i++)
+		registers.write(i, this->rx[i]);
+
+	ctrl_unit control = ctrl_unit();
+	control.set_mem(&memory);
+	control.set_reg(&registers);
+	control.set_engine(this->opts.engine);
+	control.set_idle(this->opts.idle);
+	control.set_bpoints(this->opts.bpoints, this->opts.conds);
+
+	struct fleet_result &res = this->results[id];
+	res.reason = control.run(this->opts.budget);
+	res.retired = control.get_retired();
+	res.pc = registers.get_pc();
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		res.rx[i] = registers.read(i);
+	/* behind the bus, so dumping a device range doesn't run it */
+	for (auto const& range : this->opts.ranges) {
+		const size_t at = res.words.size();
+		res.words.resize(at + range.end - range.start + 1);
+		memory.read_block(range.start, res.words.data() + at, range.end - range.start + 1);
+	}
+}
+
+/* cases group * LOCKSTEP_LANES onwards, one per lane */
+void fleet_unit::run_group(const size_t group)
+{
+	auto lanes = std::make_unique<lockstep_unit>();
+	const size_t first = group * LOCKSTEP_LANES;
+	const size_t count = std::min<size_t>(LOCKSTEP_LANES, this->cases.size() - first);
+
+	std::vector<uint16_t> image;
+	for (size_t lane = 0; lane < count; lane++) {
+		image = this->image;
+		for (auto const& poke : this->cases[first + lane].pokes)
+			image[poke.first] = poke.second;
+		lanes->load(lane, image.data(), this->pc, this->rx);
+	}
+
+	lanes->run(this->opts.budget, this->opts.bpoints, this->opts.conds);
+
+	for (size_t lane = 0; lane < count; lane++) {
+		struct fleet_result &res = this->results[first + lane];
+		res.reason = lanes->get_reason(lane);
+		res.retired = lanes->get_retired(lane);
+		res.pc = lanes->get_pc(lane);
+		for (uint16_t i = 0; i < N_OF_REGS; i++)
+			res.rx[i] = lanes->read_reg(lane, i);
+		for (auto const& range : this->opts.ranges) {
+			for (uint32_t addr = range.start; addr <= range.end; addr++)
+				res.words.push_back(lanes->read(lane, addr));
+		}
+	}
+}
+
+void fleet_unit::run(void)
+{
+	const unsigned threads = this->opts.threads ? this->opts.threads : std::thread::hardware_concurrency();
+	work_pool pool(threads);
+
+	this->results.assign(this->cases.size(), fleet_result());
+	auto start = std::chrono::steady_clock::now();
+	if (this->opts.lockstep) {
+		const size_t groups = (this->cases.size() + LOCKSTEP_LANES - 1) / LOCKSTEP_LANES;
+		pool.run(groups, [this](const size_t group) { this->run_group(group); });
+	} else {
+		pool.run(this->cases.size(), [this](const size_t id) { this->run_case(id); });
+	}
+	auto end = std::chrono::steady_clock::now();
+	this->secs = std::chrono::duration<double>(end - start).count();
+}
+
+/* one line per case, then totals */
+void fleet_unit::report(std::ostream &os)
+{
+	char buf[64];
+	os << "# case stop retired pc";
+	for (uint16_t i = 1; i < N_OF_REGS; i++)
+		os << " r" << i;
+	for (auto const& range : this->opts.ranges) {
+		snprintf(buf, sizeof(buf), " [0x%04x-0x%04x]", range.start, range.end);
+		os << buf;
+	}
+	os << "\n";
+
+	uint64_t total = 0;
+	uint64_t stops[STOP_REASONS] = { 0 };
+	for (size_t id = 0; id < this->results.size(); id++) {
+		const struct fleet_result &res = this->results[id];
+		total += res.retired;
+		if (res.reason < STOP_REASONS)
+			stops[res.reason]++;
+
+		snprintf(buf, sizeof(buf), "%zu %s %llu 0x%04x", id, stop2str(res.reason),
+			 static_cast<unsigned long long>(res.retired), res.pc);
+		os << buf;
+		for (uint16_t i = 1; i < N_OF_REGS; i++) {
+			snprintf(buf, sizeof(buf), " 0x%04x", res.rx[i]);
+			os << buf;
+		}
+		for (auto const& word : res.words) {
+			snprintf(buf, sizeof(buf), " %04x", word);
+			os << buf;
+		}
+		os << "\n";
+	}
+
+	const double mips = (this->secs > 0) ? total / this->secs / 1e6 : 0;
+	os << "# cases: " << this->results.size() << "\n";
+	os << "# retired: " << total << "\n";
+	os << "# time: " << this->secs << " s\n";
+	os << "# MIPS: " << mips << "\n";
+	os << "# stops:";
+	for (uint8_t reason = STOP_NONE; reason < STOP_REASONS; reason++)
+		os << " " << stop2str(static_cast<enum STOP_REASON>(reason)) << " " << stops[reason];
+	os << "\n";
+}
+
+/* "START:END" in hex, inclusive */
+enum GEN_ERR str2range(const char *str, struct fleet_range &range)
+{
+	const std::string text(str);
+	const size_t colon = text.find(':');
+	uint64_t start, last;
+	if (colon == std::string::npos ||
+	    str2num(text.substr(0, colon).c_str(), 16, UINT16_MAX, start) != E_OK ||
+	    str2num(text.substr(colon + 1).c_str(), 16, UINT16_MAX, last) != E_OK || start > last)
+		return E_ARG;
+
+	range.start = start;
+	range.end = last;
+	return E_OK;
+}
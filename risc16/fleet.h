@@ -0,0 +1,75 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include "modules.h"
+#include "cmdi.h"
+
+#include <cstdint>
+#include <bitset>
+#include <map>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+/* memory words copied into the report, inclusive */
+struct fleet_range {
+	uint16_t start;
+	uint16_t end;
+};
+
+/* shared by every case */
+struct fleet_opts {
+	enum ENGINE engine = ENG_SWITCH;
+	uint64_t budget = UINT64_MAX;
+	std::bitset<MEM_CAPACITY> bpoints;
+	std::map<uint16_t, struct bp_cond> conds;
+	std::vector<struct fleet_range> ranges;
+	unsigned threads = 0;	/* 0 picks one per core */
+	bool lockstep = false;	/* run cases LOCKSTEP_LANES at a time */
+	bool idle = false;	/* stop cases stuck in a loop, not with lockstep */
+};
+
+/* one line of the case file: "ADDR=DATA" pokes, in hex */
+struct fleet_case {
+	std::vector<std::pair<uint16_t, uint16_t>> pokes;
+};
+
+struct fleet_result {
+	enum STOP_REASON reason;
+	uint64_t retired;
+	uint16_t pc;
+	uint16_t rx[N_OF_REGS];
+	std::vector<uint16_t> words;	/* every fleet_range, back to back */
+};
+
+/* runs every case on its own mem_unit/reg_unit/ctrl_unit triple, or a lane
+ * of a lockstep_unit, started from the same base state, spread over a
+ * work_pool */
+class fleet_unit {
+private:
+	/* private members BEGIN */
+	struct fleet_opts opts;
+	std::vector<uint16_t> image;
+	uint16_t pc;
+	uint16_t rx[N_OF_REGS];
+
+	std::vector<struct fleet_case> cases;
+	std::vector<struct fleet_result> results;
+	double secs = 0;
+	/* private members END */
+	/* private functions BEGIN */
+	void run_case(const size_t id);
+	void run_group(const size_t group);
+	/* private functions END */
+public:
+	fleet_unit(mem_unit *mem, reg_unit *reg, const struct fleet_opts &opts);
+	~fleet_unit(void) = default;
+
+	enum GEN_ERR load_cases(const char *path);
+	void run(void);
+	void report(std::ostream &os);
+};
+
+enum GEN_ERR str2range(const char *str, struct fleet_range &range);
+
+#endif
@@ -0,0 +1,454 @@
+#include "gdb.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const char HEX[] = "0123456789abcdef";
+
+static int unhex(const char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static void put_byte(std::string &out, const uint8_t byte)
+{
+	out += HEX[byte >> 4];
+	out += HEX[byte & 0xf];
+}
+
+/* one 16-bit register, low byte first */
+static void put_word(std::string &out, const uint16_t word)
+{
+	put_byte(out, word & 0xff);
+	put_byte(out, word >> 8);
+}
+
+static bool get_byte(const std::string &in, const size_t pos, uint8_t &byte)
+{
+	if (pos + 2 > in.size())
+		return false;
+	const int hi = unhex(in[pos]);
+	const int lo = unhex(in[pos + 1]);
+	if (hi < 0 || lo < 0)
+		return false;
+	byte = hi << 4 | lo;
+	return true;
+}
+
+static bool get_word(const std::string &in, const size_t pos, uint16_t &word)
+{
+	uint8_t lo, hi;
+	if (!get_byte(in, pos, lo) || !get_byte(in, pos + 2, hi))
+		return false;
+	word = lo | hi << 8;
+	return true;
+}
+
+/* a whole hex number no larger than max that ends at stop, at is left on
+ * stop. strtoul would wrap, skip spaces and stop at any junk instead */
+static bool get_num(const char *&at, const char stop, const unsigned long max, unsigned long &num)
+{
+	const char *start = at;
+	num = 0;
+	for (; *at && *at != stop; at++) {
+		const int digit = unhex(*at);
+		if (digit < 0 || (num << 4 | digit) > max)
+			return false;
+		num = num << 4 | digit;
+	}
+	return at != start && *at == stop;
+}
+
+gdb_unit::gdb_unit(ctrl_unit *ctrl, mem_unit *mem, reg_unit *reg)
+{
+	this->ctrl = ctrl;
+	this->mem = mem;
+	this->reg = reg;
+}
+
+gdb_unit::~gdb_unit(void)
+{
+	if (this->fd >= 0)
+		close(this->fd);
+	if (this->listen_fd >= 0)
+		close(this->listen_fd);
+	if (!this->unix_path.empty())
+		unlink(this->unix_path.c_str());
+}
+
+/* a path with a '/' is a unix socket, anything else a TCP port on localhost */
+enum GEN_ERR gdb_unit::listen(const char *where)
+{
+	if (strchr(where, '/')) {
+		struct sockaddr_un addr = {};
+		if (strlen(where) >= sizeof(addr.sun_path))
+			return E_ARG;
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, where);
+		unlink(where);
+
+		this->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (this->listen_fd < 0 || bind(this->listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)))
+			return E_IO;
+		this->unix_path = std::string(where);
+	} else {
+		char *end = nullptr;
+		const unsigned long port = strtoul(where, &end, 10);
+		if (*end || !port || port > UINT16_MAX)
+			return E_ARG;
+		struct sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		this->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+		const int on = 1;
+		if (this->listen_fd < 0)
+			return E_IO;
+		setsockopt(this->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		if (bind(this->listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)))
+			return E_IO;
+	}
+
+	if (::listen(this->listen_fd, 1))
+		return E_IO;
+	std::cerr << "gdb: listening on " << where << "\n";
+	return E_OK;
+}
+
+int gdb_unit::get_char(void)
+{
+	uint8_t c;
+	return (read(this->fd, &c, 1) == 1) ? c : -1;
+}
+
+/* only looks, never waits: true if the client sent ^C */
+bool gdb_unit::poll_interrupt(void)
+{
+	struct pollfd pfd = { this->fd, POLLIN, 0 };
+	while (poll(&pfd, 1, 0) > 0) {
+		const int c = this->get_char();
+		if (c < 0 || c == 0x03)
+			return true;
+	}
+	return false;
+}
+
+/* the payload of the next well formed packet */
+enum GEN_ERR gdb_unit::get_packet(std::string &packet)
+{
+	int c;
+	for (;;) {
+		while ((c = this->get_char()) != '$') {
+			if (c < 0)
+				return E_IO;
+		}
+
+		packet.clear();
+		uint8_t sum = 0;
+		while ((c = this->get_char()) != '#') {
+			if (c < 0)
+				return E_IO;
+			if (c == '$') {
+				packet.clear();
+				sum = 0;
+				continue;
+			}
+			packet += static_cast<char>(c);
+			sum += c;
+		}
+
+		const int hi = this->get_char();
+		const int lo = this->get_char();
+		if (hi < 0 || lo < 0)
+			return E_IO;
+		if (!this->ack)
+			return E_OK;
+		if (unhex(hi) << 4 == (sum & 0xf0) && unhex(lo) == (sum & 0x0f)) {
+			write(this->fd, "+", 1);
+			return E_OK;
+		}
+		write(this->fd, "-", 1);
+	}
+}
+
+enum GEN_ERR gdb_unit::put_packet(const std::string &data)
+{
+	uint8_t sum = 0;
+	for (auto const& c : data)
+		sum += c;
+	std::string out = "$" + data + "#";
+	put_byte(out, sum);
+
+	for (;;) {
+		if (write(this->fd, out.data(), out.size()) != static_cast<ssize_t>(out.size()))
+			return E_IO;
+		if (!this->ack)
+			return E_OK;
+
+		int c;
+		while ((c = this->get_char()) != '+' && c != '-') {
+			if (c < 0)
+				return E_IO;
+		}
+		if (c == '+')
+			return E_OK;
+	}
+}
+
+std::string gdb_unit::read_regs(void)
+{
+	std::string out;
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		put_word(out, this->reg->read(i));
+	put_word(out, this->reg->get_pc());
+	return out;
+}
+
+std::string gdb_unit::read_mem(const uint32_t addr, const uint32_t len)
+{
+	std::string out;
+	for (uint32_t at = addr; at < addr + len && at < 2 * MEM_CAPACITY; at++) {
+		uint16_t word;
+		this->mem->read_block(at >> 1, &word, 1);
+		put_byte(out, (at & 1) ? word >> 8 : word & 0xff);
+	}
+	return out.empty() ? std::string("E01") : out;
+}
+
+/* like a poke from the command line: ROM included, history dropped.
+ * the whole packet is checked first so a bad one changes nothing */
+enum GEN_ERR gdb_unit::write_mem(const uint32_t addr, const std::string &hex)
+{
+	std::vector<uint8_t> bytes(hex.size() / 2);
+	if (hex.size() & 1 || addr + bytes.size() > 2 * MEM_CAPACITY)
+		return E_RANGE;
+	for (uint32_t i = 0; i < bytes.size(); i++) {
+		if (!get_byte(hex, 2 * i, bytes[i]))
+			return E_RANGE;
+	}
+
+	for (uint32_t i = 0; i < bytes.size(); i++) {
+		const uint32_t at = addr + i;
+		const uint8_t byte = bytes[i];
+		uint16_t word;
+		this->mem->read_block(at >> 1, &word, 1);
+		word = (at & 1) ? (word & 0x00ff) | byte << 8 : (word & 0xff00) | byte;
+		this->mem->write(at >> 1, word, true);
+	}
+	this->ctrl->clear_history();
+	return E_OK;
+}
+
+/* Z2-4 watch every word the byte range touches */
+enum GEN_ERR gdb_unit::set_watch(const std::string &packet, const uint32_t addr, const uint32_t len)
+{
+	static const uint8_t KINDS[3] = { WATCH_W, WATCH_R, WATCH_RW };
+	const uint8_t kind = KINDS[packet[1] - '2'];
+	const uint32_t last = addr + std::max<uint32_t>(len, 1) - 1;
+	if (last >= 2 * MEM_CAPACITY)
+		return E_RANGE;
+
+	for (uint32_t word = addr >> 1; word <= (last >> 1); word++) {
+		const enum GEN_ERR retval = (packet[0] == 'Z') ? this->mem->add_watch(word, kind) :
+			this->mem->del_watch(word, kind);
+		if (retval != E_OK)
+			return retval;
+	}
+	return E_OK;
+}
+
+std::string gdb_unit::stop_reply(const enum STOP_REASON reason)
+{
+	std::string out;
+	switch (reason) {
+	case STOP_HALT:
+		out = "W";
+		put_byte(out, this->ctrl->get_exit_code() & 0xff);
+		break;
+	case STOP_FAULT:
+		/* exc 3 is the guest's own segfault, anything else an illegal instruction */
+		out = (this->ctrl->get_exc() == EXC_SIGSEGV) ? "S0b" : "S04";
+		break;
+	case STOP_WATCH: {
+		/* gdb matches the address against its own watchpoints */
+		char buf[32];
+		const uint8_t kind = this->ctrl->get_watch_kind();
+		snprintf(buf, sizeof(buf), "T05%s:%x;", (kind == WATCH_W) ? "watch" : "rwatch",
+			 2 * this->ctrl->get_watch_addr());
+		out = std::string(buf);
+		break;
+	}
+
+	default:
+		out = "S05";
+		break;
+	};
+	return out;
+}
+
+/* continue runs in slices, the socket is polled once per slice */
+std::string gdb_unit::resume(const bool single)
+{
+	if (single)
+		return this->stop_reply(this->ctrl->resume(1));
+
+	enum STOP_REASON reason = this->ctrl->resume(POLL_TICKS);
+	while (reason == STOP_BUDGET) {
+		if (this->poll_interrupt())
+			return std::string("S02");
+		reason = this->ctrl->run(POLL_TICKS);
+	}
+	return this->stop_reply(reason);
+}
+
+std::string gdb_unit::handle(const std::string &packet)
+{
+	const char *args = packet.c_str() + 1;
+	const char *end = args;
+	char *stop = nullptr;
+	unsigned long addr, len, n;
+	uint16_t word;
+
+	switch (packet.empty() ? 0 : packet[0]) {
+	case '?':
+		return std::string("S05");
+	case 'g':
+		return this->read_regs();
+	case 'G':
+		for (uint16_t i = 0; i < GDB_REGS; i++) {
+			if (!get_word(packet, 1 + 4 * i, word))
+				return std::string("E01");
+			if (i < N_OF_REGS)
+				this->reg->write(i, word);
+			else
+				this->reg->set_pc(word);
+		}
+		this->ctrl->clear_history();
+		return std::string("OK");
+	case 'p': {
+		std::string out;
+		if (!get_num(end, 0, GDB_REGS - 1, n))
+			return std::string("E01");
+		put_word(out, (n < N_OF_REGS) ? this->reg->read(n) : this->reg->get_pc());
+		return out;
+	}
+	case 'P': {
+		if (!get_num(end, '=', GDB_REGS - 1, n) || !get_word(packet, end + 1 - packet.c_str(), word))
+			return std::string("E01");
+		if (n < N_OF_REGS)
+			this->reg->write(n, word);
+		else
+			this->reg->set_pc(word);
+		this->ctrl->clear_history();
+		return std::string("OK");
+	}
+	case 'm':
+		/* byte addresses, two per word */
+		if (!get_num(end, ',', 2 * MEM_CAPACITY - 1, addr) || !get_num(++end, 0, UINT16_MAX, len))
+			return std::string("E01");
+		return this->read_mem(addr, std::min<unsigned long>(len, GDB_PACKET_SIZE / 2));
+	case 'M':
+		if (!get_num(end, ',', 2 * MEM_CAPACITY - 1, addr) || !get_num(++end, ':', UINT16_MAX, len) ||
+		    strlen(end + 1) != 2 * len)
+			return std::string("E01");
+		return (this->write_mem(addr, std::string(end + 1)) == E_OK) ? std::string("OK") : std::string("E01");
+	case 'Z':
+	case 'z':
+		if (packet.size() < 3 || packet[1] < '0' || packet[1] > '4' || packet[2] != ',')
+			return std::string();
+		addr = strtoul(packet.c_str() + 3, &stop, 16);
+		if (addr >= 2 * MEM_CAPACITY)
+			return std::string("E01");
+
+		/* software and hardware breakpoints are both bpoints */
+		if (packet[1] == '0' || packet[1] == '1') {
+			if (packet[0] == 'Z')
+				this->ctrl->add_bpoint(addr >> 1);
+			else
+				this->ctrl->del_bpoint(addr >> 1);
+			return std::string("OK");
+		}
+		return (this->set_watch(packet, addr, (*stop == ',') ? strtoul(stop + 1, nullptr, 16) : 1) == E_OK) ?
+			std::string("OK") : std::string("E01");
+	case 'c':
+	case 's':
+		/* a new pc invalidates the history like set-pc does */
+		if (*args) {
+			if (!get_num(end, 0, 2 * MEM_CAPACITY - 1, addr))
+				return std::string("E01");
+			this->reg->set_pc(addr >> 1);
+			this->ctrl->clear_history();
+		}
+		return this->resume(packet[0] == 's');
+	case 'H':
+	case 'T':
+		return std::string("OK");
+	case 'D':
+		this->attached = false;
+		return std::string("OK");
+	case 'q':
+		if (packet == "qC")
+			return std::string("QC1");
+		if (packet == "qfThreadInfo")
+			return std::string("m1");
+		if (packet == "qsThreadInfo")
+			return std::string("l");
+		if (packet == "qAttached")
+			return std::string("1");
+		if (packet.compare(0, 10, "qSupported") == 0) {
+			char buf[64];
+			snprintf(buf, sizeof(buf), "PacketSize=%x;QStartNoAckMode+", GDB_PACKET_SIZE);
+			return std::string(buf);
+		}
+		return std::string();
+	case 'Q':
+		if (packet == "QStartNoAckMode")
+			return std::string("OK");
+		return std::string();
+
+	default:
+		return std::string();
+	};
+}
+
+/* serves one client until it detaches, kills or hangs up */
+enum GEN_ERR gdb_unit::serve(void)
+{
+	this->fd = accept(this->listen_fd, nullptr, nullptr);
+	if (this->fd < 0)
+		return E_IO;
+	const int on = 1;
+	setsockopt(this->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+	std::string packet;
+	this->attached = true;
+	while (this->attached && this->get_packet(packet) == E_OK) {
+		if (packet == "k")
+			break;
+		if (this->put_packet(this->handle(packet)) != E_OK)
+			return E_IO;
+		if (packet == "QStartNoAckMode")
+			this->ack = false;
+	}
+	return E_OK;
+}
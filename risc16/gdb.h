@@ -0,0 +1,51 @@
+#ifndef GDB_H
+#define GDB_H
+
+#include "modules.h"
+#include "cmdi.h"
+
+#include <cstdint>
+#include <string>
+
+#define GDB_PACKET_SIZE	4096
+#define GDB_REGS	(N_OF_REGS + 1)	/* $r0-$r7, then $pc */
+
+/* gdb remote serial protocol stub on a TCP port of localhost or a unix
+ * socket. registers go out as 16-bit little endian words, memory is byte
+ * addressed with word N at bytes 2N (low) and 2N+1 (high) */
+class gdb_unit {
+private:
+	/* private members BEGIN */
+	ctrl_unit *ctrl = nullptr;
+	mem_unit *mem = nullptr;
+	reg_unit *reg = nullptr;
+
+	int listen_fd = -1;
+	int fd = -1;
+	std::string unix_path;
+	bool ack = true;
+	bool attached = false;
+	/* private members END */
+	/* private functions BEGIN */
+	int get_char(void);
+	bool poll_interrupt(void);
+	enum GEN_ERR get_packet(std::string &packet);
+	enum GEN_ERR put_packet(const std::string &data);
+
+	std::string read_regs(void);
+	std::string read_mem(const uint32_t addr, const uint32_t len);
+	enum GEN_ERR write_mem(const uint32_t addr, const std::string &hex);
+	enum GEN_ERR set_watch(const std::string &packet, const uint32_t addr, const uint32_t len);
+	std::string stop_reply(const enum STOP_REASON reason);
+	std::string resume(const bool single);
+	std::string handle(const std::string &packet);
+	/* private functions END */
+public:
+	gdb_unit(ctrl_unit *ctrl, mem_unit *mem, reg_unit *reg);
+	~gdb_unit(void);
+
+	enum GEN_ERR listen(const char *where);
+	enum GEN_ERR serve(void);
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <cstdint>
+
+/* switch core instruction handlers
+ *
+ * one handler per opcode and per combination of rA/rB/rC being $r0 or
+ * not, picked once when the instruction is predecoded. reads of $r0 are
+ * the constant 0 and writes to it are never emitted, so the handlers index
+ * the register file without checking the register numbers. flags for
+ * fields an opcode doesn't have are always false */
+
+template <enum RISC16 OP, bool RA, bool RB, bool RC>
+void ctrl_unit::__op(void)
+{
+	uint16_t *rx = this->reg->rx.data();
+	const uint16_t a = RA ? rx[instr.rA] : 0;
+	const uint16_t b = RB ? rx[instr.rB] : 0;
+	const uint16_t c = RC ? rx[instr.rC] : 0;
+	const uint16_t pc = this->reg->pc;
+	uint16_t result = 0;
+
+	mem->rom_ptr = pc;
+	this->reg->pc = pc + 1;
+
+	if constexpr (OP == __ADD) {
+		result = b + c;
+	} else if constexpr (OP == __ADDI) {
+		result = b + instr.imm;
+	} else if constexpr (OP == __NAND) {
+		result = ~(b & c);
+	} else if constexpr (OP == __LUI) {
+		result = (instr.imm << 6) & MASK_LUI;
+	} else if constexpr (OP == __SW) {
+		mem->ram_ptr = instr.imm + b;
+		if (mem->ram_ptr >= RAM_START && mem->ram_ptr < RAM_END)
+			mem->write(mem->ram_ptr, a, false);
+	} else if constexpr (OP == __LW) {
+		/* device reads have side effects, even into $r0 */
+		mem->ram_ptr = instr.imm + b;
+		result = mem->read(mem->ram_ptr);
+	} else if constexpr (OP == __BEQ) {
+		if (a == b)
+			this->reg->pc = pc + 1 + instr.imm;
+	} else if constexpr (OP == __JALR) {
+		/* b was read before rA is written in case if rA == rB */
+		result = pc + 1;
+		this->reg->pc = b;
+	}
+
+	if constexpr (RA && OP != __SW && OP != __BEQ) {
+		rx[instr.rA] = result;
+		this->reg->dirty |= 1 << instr.rA;
+	}
+	return;
+}
+
+#define HANDLERS_C(op, ra, rb)							\
+	{ &ctrl_unit::__op<op, ra, rb, false>, &ctrl_unit::__op<op, ra, rb, true> }
+#define HANDLERS_B(op, ra)							\
+	{ HANDLERS_C(op, ra, false), HANDLERS_C(op, ra, true) }
+#define HANDLERS_A(op)								\
+	{ HANDLERS_B(op, false), HANDLERS_B(op, true) }
+
+ctrl_unit::handler_fn ctrl_unit::select(const instr_t &in)
+{
+	static const handler_fn handlers[__EXT][2][2][2] = {
+		HANDLERS_A(__ADD), HANDLERS_A(__ADDI), HANDLERS_A(__NAND), HANDLERS_A(__LUI),
+		HANDLERS_A(__SW), HANDLERS_A(__LW), HANDLERS_A(__BEQ), HANDLERS_A(__JALR)
+	};
+
+	if (in.opcode == __EXT)
+		return &ctrl_unit::__ext;
+	return handlers[in.opcode][in.rA != 0][in.rB != 0][in.rC != 0];
+}
@@ -0,0 +1,87 @@
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <cstring>
+
+/* control unit idle detection BEGIN */
+void ctrl_unit::set_idle(const bool on)
+{
+	this->idle = on;
+}
+
+/* follows the machine on the side for up to IDLE_PROBE instructions. if it
+ * comes back to the same $pc with the same registers without storing to
+ * RAM, touching a device, trapping or passing a breakpoint, nothing can
+ * ever change its course again */
+bool ctrl_unit::stuck(void)
+{
+	uint16_t start[N_OF_REGS];
+	uint16_t rx[N_OF_REGS];
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		start[i] = rx[i] = this->reg->read(i);
+	const uint16_t entry = this->reg->get_pc();
+	uint16_t pc = entry;
+	uint16_t word, addr;
+	instr_t in;
+
+	for (uint32_t i = 0; i < IDLE_PROBE; i++) {
+		if (i && pc == entry && !memcmp(rx, start, sizeof(rx)))
+			return true;
+		if (i && this->bpoints.test(pc))
+			return false;
+
+		this->mem->read_block(pc, &word, 1);
+		if (in.decode(word) != E_OK)
+			return false;
+
+		switch (in.opcode) {
+		case __ADD:
+			rx[in.rA] = rx[in.rB] + rx[in.rC];
+			pc++;
+			break;
+		case __ADDI:
+			rx[in.rA] = rx[in.rB] + in.imm;
+			pc++;
+			break;
+		case __NAND:
+			rx[in.rA] = ~(rx[in.rB] & rx[in.rC]);
+			pc++;
+			break;
+		case __LUI:
+			rx[in.rA] = (in.imm << 6) & MASK_LUI;
+			pc++;
+			break;
+		case __SW:
+			addr = in.imm + rx[in.rB];
+			if (addr >= RAM_START && addr < RAM_END)
+				return false;
+			pc++;
+			break;
+		case __LW:
+			addr = in.imm + rx[in.rB];
+			if (this->mem->is_device(addr))
+				return false;
+			this->mem->read_block(addr, &rx[in.rA], 1);
+			pc++;
+			break;
+		case __BEQ:
+			if (rx[in.rA] == rx[in.rB])
+				pc = pc + 1 + in.imm;
+			else
+				pc++;
+			break;
+		case __JALR:
+			addr = pc + 1;
+			pc = rx[in.rB];
+			rx[in.rA] = addr;
+			break;
+
+		default:
+			return false;
+		};
+		rx[0] = 0;
+	}
+	return false;
+}
+/* control unit idle detection END */
@@ -0,0 +1,174 @@
+#include "image.h"
+#include "modules.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* granularity used when splitting memory into segments on save */
+static const uint32_t IMG_PAGE = 256;
+
+bool is_image(const char *path)
+{
+	char magic[4] = { 0 };
+	std::ifstream file(path, std::ios::binary);
+	file.read(magic, sizeof(magic));
+	return file && !memcmp(magic, IMG_MAGIC, sizeof(magic));
+}
+
+enum GEN_ERR mem_unit::fill_image(const char *path)
+{
+	enum GEN_ERR retval = E_OK;
+
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		retval = E_IO;
+		std::cerr << "ERR " << retval << ": file \"" << path << "\" not found\n";
+		if (fd >= 0)
+			close(fd);
+		return retval;
+	}
+
+	const size_t size = st.st_size;
+	void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		retval = E_IO;
+		std::cerr << "ERR " << retval << ": can't map \"" << path << "\"\n";
+		return retval;
+	}
+	const uint8_t *base = static_cast<const uint8_t *>(map);
+
+	struct img_header hdr = {};
+	if (size >= sizeof(hdr))
+		memcpy(&hdr, base, sizeof(hdr));
+	const size_t seg_end = sizeof(hdr) + hdr.n_segments * sizeof(struct img_segment);
+	if (size < sizeof(hdr) || hdr.version != IMG_VERSION || seg_end > size) {
+		retval = E_IO;
+		std::cerr << "ERR " << retval << ": unsupported image \"" << path << "\"\n";
+		munmap(map, size);
+		return retval;
+	}
+
+	/* everything is checked before memory is touched, a bad image leaves
+	 * the old program, its symbols and its translations alone */
+	std::vector<struct img_segment> segs(hdr.n_segments);
+	for (uint16_t i = 0; i < hdr.n_segments && retval == E_OK; i++) {
+		struct img_segment &seg = segs[i];
+		memcpy(&seg, base + sizeof(hdr) + i * sizeof(seg), sizeof(seg));
+		if (seg.addr + seg.words > MEM_CAPACITY ||
+		    seg.offset + seg.words * sizeof(uint16_t) > size) {
+			retval = E_RANGE;
+			std::cerr << "ERR " << retval << ": segment " << i << " out of range\n";
+		}
+	}
+
+	std::map<uint16_t, std::string> symbols;
+	size_t pos = hdr.sym_offset;
+	for (uint16_t i = 0; i < hdr.n_symbols && hdr.sym_offset && retval == E_OK; i++) {
+		uint16_t addr = 0;
+		uint8_t len = 0;
+		bool fits = (pos + sizeof(addr) + sizeof(len) <= size);
+		if (fits) {
+			memcpy(&addr, base + pos, sizeof(addr));
+			len = base[pos + sizeof(addr)];
+			pos += sizeof(addr) + sizeof(len);
+			fits = (pos + len <= size);
+		}
+		if (!fits) {
+			retval = E_RANGE;
+			std::cerr << "ERR " << retval << ": symbol " << i << " out of range\n";
+			break;
+		}
+		symbols[addr] = std::string(reinterpret_cast<const char *>(base + pos), len);
+		pos += len;
+	}
+
+	/* segment data may sit at odd offsets, so it's copied out before
+	 * write_block drops whatever was decoded from the old words */
+	std::vector<uint16_t> words;
+	for (auto const& seg : segs) {
+		if (retval != E_OK)
+			break;
+		words.resize(seg.words);
+		memcpy(words.data(), base + seg.offset, seg.words * sizeof(uint16_t));
+		this->write_block(seg.addr, words.data(), seg.words);
+	}
+	if (retval == E_OK)
+		this->symbols.swap(symbols);
+
+	munmap(map, size);
+	return retval;
+}
+
+/* writes every non-empty page run as one segment, plus loaded symbols */
+enum GEN_ERR mem_unit::save_image(const char *path)
+{
+	enum GEN_ERR retval = E_OK;
+
+	std::vector<struct img_segment> segs;
+	for (uint32_t page = 0; page < MEM_CAPACITY; page += IMG_PAGE) {
+		bool empty = true;
+		for (uint32_t addr = page; addr < page + IMG_PAGE && empty; addr++)
+			empty = (this->mem[addr] == 0);
+		if (empty)
+			continue;
+
+		if (!segs.empty() && segs.back().addr + segs.back().words == page)
+			segs.back().words += IMG_PAGE;
+		else
+			segs.push_back({ 0, IMG_PAGE, static_cast<uint16_t>(page), 0 });
+	}
+
+	uint32_t offset = sizeof(struct img_header) + segs.size() * sizeof(struct img_segment);
+	for (auto &seg : segs) {
+		while (seg.words > 0 && this->mem[seg.addr + seg.words - 1] == 0)
+			seg.words--;
+		seg.offset = offset;
+		offset += seg.words * sizeof(uint16_t);
+	}
+
+	struct img_header hdr;
+	memcpy(hdr.magic, IMG_MAGIC, sizeof(hdr.magic));
+	hdr.version = IMG_VERSION;
+	hdr.n_segments = segs.size();
+	hdr.n_symbols = this->symbols.size();
+	hdr.reserved = 0;
+	hdr.sym_offset = this->symbols.empty() ? 0 : offset;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		retval = E_IO;
+		std::cerr << "ERR " << retval << ": can't open \"" << path << "\"\n";
+		return retval;
+	}
+	file.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+	file.write(reinterpret_cast<const char *>(segs.data()), segs.size() * sizeof(struct img_segment));
+	for (auto const& seg : segs)
+		file.write(reinterpret_cast<const char *>(&this->mem[seg.addr]), seg.words * sizeof(uint16_t));
+	for (auto const& sym : this->symbols) {
+		const uint8_t len = std::min<size_t>(sym.second.size(), UINT8_MAX);
+		file.write(reinterpret_cast<const char *>(&sym.first), sizeof(sym.first));
+		file.write(reinterpret_cast<const char *>(&len), sizeof(len));
+		file.write(sym.second.data(), len);
+	}
+
+	if (!file) {
+		retval = E_IO;
+		std::cerr << "ERR " << retval << ": failed writing \"" << path << "\"\n";
+	}
+	return retval;
+}
+
+const std::map<uint16_t, std::string> &mem_unit::get_symbols(void)
+{
+	return this->symbols;
+}
@@ -0,0 +1,38 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <cstdint>
+
+/* binary ROM image, all fields in host byte order
+ *
+ *	img_header
+ *	img_segment[n_segments]
+ *	segment data, words in load order
+ *	symbol section at sym_offset: n_symbols of
+ *		uint16_t addr, uint8_t len, char name[len]
+ */
+#define IMG_MAGIC	"R16I"
+#define IMG_VERSION	1
+
+struct img_header {
+	char magic[4];
+	uint16_t version;
+	uint16_t n_segments;
+	uint16_t n_symbols;
+	uint16_t reserved;
+	uint32_t sym_offset;	/* 0 when there are no symbols */
+};
+
+struct img_segment {
+	uint32_t offset;	/* bytes from the start of the file */
+	uint32_t words;
+	uint16_t addr;		/* load address */
+	uint16_t reserved;
+};
+
+static_assert(sizeof(struct img_header) == 16, "img_header must stay packed");
+static_assert(sizeof(struct img_segment) == 12, "img_segment must stay packed");
+
+bool is_image(const char *path);
+
+#endif
@@ -0,0 +1,540 @@
+#include "jit.h"
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+#include <sys/mman.h>
+
+/* host registers */
+enum HREG : uint8_t {
+	RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+	R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+/* guest register -> host register, r0 has no home
+ * rbp holds the register file, r14 the memory array and r15 the mem_unit */
+static const uint8_t GREG[N_OF_REGS] = { RAX, RBX, R12, R13, R8, R9, R10, R11 };
+
+/* host bytes of the longest sequences below, a register move with rex
+ * takes 3, add_ri 6, movzx16 3, a push or pop of r8-r11 2 and movabs 10 */
+static constexpr size_t CALL_BYTES = 4 * 2 + 3 + 10 + 2 + 4 * 2;	/* saves, mov rdi, movabs, call, restores */
+static constexpr size_t SW_BYTES = 3 + 6 + 3 + 3 + 3 + CALL_BYTES;
+static constexpr size_t LW_BYTES = 3 + 6 + 3 + 10 + 3 + 5 + 3;
+static constexpr size_t LW_DEV_BYTES = 3 + 6 + 3 + CALL_BYTES + 3;
+static constexpr size_t BEQ_BYTES = 3 + 3 + 1 + 3 + 5 + 5 + 3;
+/* pushes, sub rsp, three movs, two stack slot stores, seven register
+ * loads, then the budget check: cmp, jae, exit, sub and add */
+static constexpr size_t PROLOGUE_BYTES = 10 + 4 + 3 * 3 + 4 + 9 + 7 * 5 + 5 + 2 + 5 + 5 + 5 + 6;
+/* next $pc, last $pc store, range check, table load and the jumps */
+static constexpr size_t CHAIN_BYTES = 5 + 9 + 5 + 6 + 10 + 4 + 3 + 6 + 2;
+
+/* worst case host bytes per guest instruction plus prologue/chaining */
+static constexpr size_t MAX_INSTR_BYTES = 52;
+static constexpr size_t MAX_FRAME_BYTES = 192;
+static_assert(SW_BYTES <= MAX_INSTR_BYTES && LW_BYTES <= MAX_INSTR_BYTES && LW_DEV_BYTES <= MAX_INSTR_BYTES &&
+	      BEQ_BYTES <= MAX_INSTR_BYTES,
+	      "MAX_INSTR_BYTES is below the longest translated instruction");
+static_assert(PROLOGUE_BYTES + CHAIN_BYTES <= MAX_FRAME_BYTES, "MAX_FRAME_BYTES is below the block frame");
+
+/* stores go through mem_unit so invalidation and range checks hold */
+static void jit_store(mem_unit *mem, const uint32_t addr, const uint32_t data)
+{
+	mem->ram_ptr = addr;
+	if (addr >= RAM_START && addr < RAM_END)
+		mem->write(addr, data, false);
+}
+
+/* loads go through mem_unit only while some device intercepts them */
+static uint32_t jit_load(mem_unit *mem, const uint32_t addr)
+{
+	return mem->read(addr);
+}
+
+jit_unit::jit_unit(mem_unit *mem, reg_unit *reg)
+{
+	this->mem = mem;
+	this->reg = reg;
+	this->blocks.resize(ROM_END + 1);
+	this->hits.resize(ROM_END + 1);
+	this->chain.resize(ROM_END + 1);
+
+#if defined(__x86_64__)
+	void *buf = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf != MAP_FAILED)
+		this->code = static_cast<uint8_t *>(buf);
+#endif
+	this->flush();
+}
+
+jit_unit::~jit_unit(void)
+{
+	if (this->code)
+		munmap(this->code, JIT_CODE_SIZE);
+}
+
+bool jit_unit::ready(void)
+{
+	return this->code != nullptr;
+}
+
+/* emitter BEGIN */
+void jit_unit::emit8(const uint8_t byte)
+{
+	*this->cur++ = byte;
+}
+
+void jit_unit::emit32(const uint32_t word)
+{
+	memcpy(this->cur, &word, sizeof(word));
+	this->cur += sizeof(word);
+}
+
+void jit_unit::emit64(const uint64_t word)
+{
+	memcpy(this->cur, &word, sizeof(word));
+	this->cur += sizeof(word);
+}
+
+void jit_unit::rex(const bool wide, const uint8_t reg, const uint8_t rm)
+{
+	uint8_t prefix = 0x40 | (wide << 3) | ((reg >> 3) << 2) | (rm >> 3);
+	if (prefix != 0x40)
+		this->emit8(prefix);
+}
+
+/* op r/m32, r32 */
+void jit_unit::op_rr(const uint8_t op, const uint8_t rm, const uint8_t reg)
+{
+	this->rex(false, reg, rm);
+	this->emit8(op);
+	this->emit8(0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+
+void jit_unit::mov_rr(const uint8_t dst, const uint8_t src)
+{
+	this->op_rr(0x89, dst, src);
+}
+
+void jit_unit::mov_ri(const uint8_t dst, const uint32_t imm)
+{
+	this->rex(false, 0, dst);
+	this->emit8(0xb8 | (dst & 7));
+	this->emit32(imm);
+}
+
+void jit_unit::add_ri(const uint8_t dst, const uint32_t imm)
+{
+	this->rex(false, 0, dst);
+	this->emit8(0x81);
+	this->emit8(0xc0 | (dst & 7));
+	this->emit32(imm);
+}
+
+void jit_unit::movzx16(const uint8_t dst, const uint8_t src)
+{
+	this->rex(false, dst, src);
+	this->emit8(0x0f);
+	this->emit8(0xb7);
+	this->emit8(0xc0 | (dst & 7) << 3 | (src & 7));
+}
+
+/* dst = guest register, upper half of dst is undefined */
+void jit_unit::get_greg(const uint8_t dst, const uint8_t greg)
+{
+	if (greg)
+		this->mov_rr(dst, GREG[greg]);
+	else
+		this->op_rr(0x31, dst, dst);
+}
+
+/* movzx dst, word [rbp + 2 * greg] */
+void jit_unit::load_greg(const uint8_t dst, const uint8_t greg)
+{
+	this->rex(false, dst, RBP);
+	this->emit8(0x0f);
+	this->emit8(0xb7);
+	this->emit8(0x40 | (dst & 7) << 3 | (RBP & 7));
+	this->emit8(greg * sizeof(uint16_t));
+}
+
+/* mov word [rbp + 2 * greg], src */
+void jit_unit::store_greg(const uint8_t greg, const uint8_t src)
+{
+	this->emit8(0x66);
+	this->rex(false, src, RBP);
+	this->emit8(0x89);
+	this->emit8(0x40 | (src & 7) << 3 | (RBP & 7));
+	this->emit8(greg * sizeof(uint16_t));
+}
+
+/* movzx dst, word [r14 + rax * 2] */
+void jit_unit::load_mem(const uint8_t dst)
+{
+	this->rex(false, dst, R14);
+	this->emit8(0x0f);
+	this->emit8(0xb7);
+	this->emit8(0x04 | (dst & 7) << 3);
+	this->emit8(0x46);
+}
+
+void jit_unit::push(const uint8_t reg)
+{
+	if (reg >= R8)
+		this->emit8(0x41);
+	this->emit8(0x50 | (reg & 7));
+}
+
+void jit_unit::pop(const uint8_t reg)
+{
+	if (reg >= R8)
+		this->emit8(0x41);
+	this->emit8(0x58 | (reg & 7));
+}
+
+/* jcc/jmp rel32 to an already emitted target */
+void jit_unit::jump(const uint8_t cond, const uint8_t *target)
+{
+	if (cond) {
+		this->emit8(0x0f);
+		this->emit8(cond);
+	} else {
+		this->emit8(0xe9);
+	}
+	this->emit32(target - (this->cur + sizeof(uint32_t)));
+}
+/* emitter END */
+
+/* shared exit: eax holds the next $pc, [rsp + 8] the retired count and
+ * [rsp + 16] the address of the last instruction run, which goes into
+ * bits 16-31 of the result */
+void jit_unit::emit_exit(void)
+{
+	for (uint8_t i = 1; i < N_OF_REGS; i++)
+		this->store_greg(i, GREG[i]);
+	this->emit8(0x0f); this->emit8(0xb7); this->emit8(0x54); this->emit8(0x24); this->emit8(0x10);	/* movzx edx, word [rsp + 16] */
+	this->emit8(0xc1); this->emit8(0xe2); this->emit8(0x10);	/* shl edx, 16 */
+	this->emit8(0x09); this->emit8(0xd0);	/* or eax, edx */
+	this->emit8(0x48); this->emit8(0x8b); this->emit8(0x54); this->emit8(0x24); this->emit8(0x08);	/* mov rdx, [rsp + 8] */
+	this->emit8(0x48); this->emit8(0xc1); this->emit8(0xe2); this->emit8(0x20);	/* shl rdx, 32 */
+	this->emit8(0x48); this->emit8(0x09); this->emit8(0xd0);	/* or rax, rdx */
+	this->emit8(0x48); this->emit8(0x83); this->emit8(0xc4); this->emit8(0x18);	/* add rsp, 24 */
+	this->pop(R15);
+	this->pop(R14);
+	this->pop(R13);
+	this->pop(R12);
+	this->pop(RBP);
+	this->pop(RBX);
+	this->emit8(0xc3);
+}
+
+bool jit_unit::compile(const uint16_t start, const std::bitset<MEM_CAPACITY> &bpoints)
+{
+#if defined(__x86_64__)
+	if (!this->code)
+		return false;
+
+	/* decode the whole block before emitting anything */
+	std::vector<instr_t> body;
+	uint16_t addr = start;
+	bool branch = false;
+	while (body.size() < JIT_MAX_BLOCK && addr <= ROM_END && !branch) {
+		/* a breakpoint has to be reached by the interpreter */
+		if (addr != start && bpoints.test(addr))
+			break;
+
+		instr_t instr;
+		/* EXT is left to the interpreter */
+		if (instr.decode(this->mem->read(addr)) != E_OK || instr.opcode == __EXT)
+			break;
+
+		branch = (instr.opcode == __BEQ || instr.opcode == __JALR);
+		body.push_back(instr);
+		addr++;
+	}
+	if (body.empty())
+		return false;
+
+	if (this->cur + MAX_FRAME_BYTES + body.size() * MAX_INSTR_BYTES > this->code + JIT_CODE_SIZE)
+		this->flush();
+
+	const uint8_t len = body.size();
+	uint8_t *entry = this->cur;
+
+	/* prologue: callee-saved registers, stack slots for the remaining
+	 * budget, the retired count and the last $pc, 16 byte aligned */
+	this->push(RBX);
+	this->push(RBP);
+	this->push(R12);
+	this->push(R13);
+	this->push(R14);
+	this->push(R15);
+	this->emit8(0x48); this->emit8(0x83); this->emit8(0xec); this->emit8(0x18);	/* sub rsp, 24 */
+	this->rex(true, RDI, RBP); this->emit8(0x89); this->emit8(0xc0 | (RDI & 7) << 3 | (RBP & 7));
+	this->rex(true, RSI, R14); this->emit8(0x89); this->emit8(0xc0 | (RSI & 7) << 3 | (R14 & 7));
+	this->rex(true, RDX, R15); this->emit8(0x89); this->emit8(0xc0 | (RDX & 7) << 3 | (R15 & 7));
+	this->emit8(0x48); this->emit8(0x89); this->emit8(0x0c); this->emit8(0x24);	/* mov [rsp], rcx */
+	this->emit8(0x48); this->emit8(0xc7); this->emit8(0x44); this->emit8(0x24); this->emit8(0x08);
+	this->emit32(0);	/* mov qword [rsp + 8], 0 */
+	for (uint8_t i = 1; i < N_OF_REGS; i++)
+		this->load_greg(GREG[i], i);
+
+	/* chained entry: leave if the budget can't cover the whole block */
+	uint8_t *body_entry = this->cur;
+	this->emit8(0x48); this->emit8(0x83); this->emit8(0x3c); this->emit8(0x24); this->emit8(len);	/* cmp qword [rsp], len */
+	this->emit8(0x73); this->emit8(0x00);	/* jae body */
+	uint8_t *skip = this->cur;
+	this->mov_ri(RAX, start);
+	this->jump(0, this->exit_stub);
+	skip[-1] = this->cur - skip;
+	this->emit8(0x48); this->emit8(0x83); this->emit8(0x2c); this->emit8(0x24); this->emit8(len);	/* sub qword [rsp], len */
+	this->emit8(0x48); this->emit8(0x83); this->emit8(0x44); this->emit8(0x24); this->emit8(0x08);
+	this->emit8(len);	/* add qword [rsp + 8], len */
+	assert(static_cast<size_t>(this->cur - entry) <= PROLOGUE_BYTES);
+
+	/* body, the next $pc ends up in eax */
+	bool pc_in_eax = false;
+	addr = start;
+	for (auto const& in : body) {
+		const uint8_t dst = GREG[in.rA];
+		const uint8_t *before = this->cur;
+		switch (in.opcode) {
+		case __ADD:
+			if (!in.rA)
+				break;
+			this->get_greg(RAX, in.rB);
+			if (in.rC)
+				this->op_rr(0x01, RAX, GREG[in.rC]);
+			this->mov_rr(dst, RAX);
+			break;
+		case __ADDI:
+			if (!in.rA)
+				break;
+			this->get_greg(RAX, in.rB);
+			this->add_ri(RAX, in.imm);
+			this->mov_rr(dst, RAX);
+			break;
+		case __NAND:
+			if (!in.rA)
+				break;
+			this->get_greg(RAX, in.rB);
+			if (in.rC)
+				this->op_rr(0x21, RAX, GREG[in.rC]);
+			else
+				this->op_rr(0x31, RAX, RAX);
+			this->emit8(0xf7); this->emit8(0xd0);	/* not eax */
+			this->mov_rr(dst, RAX);
+			break;
+		case __LUI:
+			if (in.rA)
+				this->mov_ri(dst, (in.imm << 6) & MASK_LUI);
+			break;
+		case __LW:
+			if (this->mem->dev_reads) {
+				this->get_greg(RSI, in.rB);
+				this->add_ri(RSI, in.imm);
+				this->movzx16(RSI, RSI);
+				this->push(R8);
+				this->push(R9);
+				this->push(R10);
+				this->push(R11);
+				this->rex(true, R15, RDI); this->emit8(0x89); this->emit8(0xc0 | (R15 & 7) << 3 | (RDI & 7));
+				this->emit8(0x48); this->emit8(0xb8);	/* mov rax, jit_load */
+				this->emit64(reinterpret_cast<uint64_t>(&jit_load));
+				this->emit8(0xff); this->emit8(0xd0);	/* call rax */
+				this->pop(R11);
+				this->pop(R10);
+				this->pop(R9);
+				this->pop(R8);
+				if (in.rA)
+					this->mov_rr(dst, RAX);
+				break;
+			}
+			this->get_greg(RAX, in.rB);
+			this->add_ri(RAX, in.imm);
+			this->movzx16(RAX, RAX);
+			/* the RAM pane follows loads like in the interpreters */
+			this->emit8(0x48); this->emit8(0xba);	/* mov rdx, &ram_ptr */
+			this->emit64(reinterpret_cast<uint64_t>(&this->mem->ram_ptr));
+			this->emit8(0x66); this->emit8(0x89); this->emit8(0x02);	/* mov [rdx], ax */
+			this->load_mem(RCX);
+			if (in.rA)
+				this->mov_rr(dst, RCX);
+			break;
+		case __SW:
+			this->get_greg(RSI, in.rB);
+			this->add_ri(RSI, in.imm);
+			this->movzx16(RSI, RSI);
+			this->get_greg(RDX, in.rA);
+			this->movzx16(RDX, RDX);
+			this->push(R8);
+			this->push(R9);
+			this->push(R10);
+			this->push(R11);
+			this->rex(true, R15, RDI); this->emit8(0x89); this->emit8(0xc0 | (R15 & 7) << 3 | (RDI & 7));
+			this->emit8(0x48); this->emit8(0xb8);	/* mov rax, jit_store */
+			this->emit64(reinterpret_cast<uint64_t>(&jit_store));
+			this->emit8(0xff); this->emit8(0xd0);	/* call rax */
+			this->pop(R11);
+			this->pop(R10);
+			this->pop(R9);
+			this->pop(R8);
+			break;
+		case __BEQ:
+			if (in.rA == in.rB) {
+				this->mov_ri(RAX, static_cast<uint16_t>(addr + 1 + in.imm));
+			} else {
+				this->get_greg(RCX, in.rA);
+				this->get_greg(RDX, in.rB);
+				this->emit8(0x66);
+				this->op_rr(0x39, RCX, RDX);	/* cmp cx, dx */
+				this->mov_ri(RAX, addr + 1);
+				this->mov_ri(RCX, static_cast<uint16_t>(addr + 1 + in.imm));
+				this->rex(false, RAX, RCX);	/* cmove eax, ecx */
+				this->emit8(0x0f); this->emit8(0x44); this->emit8(0xc0 | (RAX & 7) << 3 | (RCX & 7));
+			}
+			pc_in_eax = true;
+			break;
+		case __JALR:
+			/* target is read before rA is written */
+			this->get_greg(RAX, in.rB);
+			this->movzx16(RAX, RAX);
+			if (in.rA)
+				this->mov_ri(dst, addr + 1);
+			pc_in_eax = true;
+			break;
+		default:
+			break;
+		};
+		assert(static_cast<size_t>(this->cur - before) <= MAX_INSTR_BYTES);
+		addr++;
+	}
+	if (!pc_in_eax)
+		this->mov_ri(RAX, addr);
+	this->emit8(0x48); this->emit8(0xc7); this->emit8(0x44); this->emit8(0x24); this->emit8(0x10);
+	this->emit32(addr - 1);	/* mov qword [rsp + 16], last */
+
+	/* chain straight into the next translated block, if there is one */
+	this->emit8(0x3d); this->emit32(ROM_END);	/* cmp eax, ROM_END */
+	this->jump(0x87, this->exit_stub);		/* ja exit */
+	this->emit8(0x48); this->emit8(0xba);		/* mov rdx, chain */
+	this->emit64(reinterpret_cast<uint64_t>(this->chain.data()));
+	this->emit8(0x48); this->emit8(0x8b); this->emit8(0x14); this->emit8(0xc2);	/* mov rdx, [rdx + rax * 8] */
+	this->emit8(0x48); this->emit8(0x85); this->emit8(0xd2);	/* test rdx, rdx */
+	this->jump(0x84, this->exit_stub);		/* jz exit */
+	this->emit8(0xff); this->emit8(0xe2);		/* jmp rdx */
+	assert(static_cast<size_t>(this->cur - entry) <= MAX_FRAME_BYTES + len * MAX_INSTR_BYTES);
+
+	jit_block &block = this->blocks[start];
+	block.fn = reinterpret_cast<jit_fn>(entry);
+	block.len = len;
+	block.last = start + len - 1;
+	/* chained jumps skip the breakpoint check of the dispatcher */
+	if (!bpoints.test(start))
+		this->chain[start] = body_entry;
+	for (uint16_t i = start; i <= block.last; i++)
+		this->covered.set(i);
+	return true;
+#else
+	return false;
+#endif
+}
+
+/* returns the translated block at pc once it got hot enough */
+jit_block *jit_unit::lookup(const uint16_t pc, const std::bitset<MEM_CAPACITY> &bpoints)
+{
+	jit_block &block = this->blocks[pc];
+	if (block.fn)
+		return &block;
+
+	if (++this->hits[pc] < JIT_THRESHOLD)
+		return nullptr;
+
+	this->hits[pc] = 0;
+	if (!this->compile(pc, bpoints))
+		return nullptr;
+	return &block;
+}
+
+/* runs block and whatever it chains into, at most budget instructions */
+uint64_t jit_unit::enter(const jit_block *block, const uint64_t budget)
+{
+	uint64_t res = block->fn(this->reg->rx.data(), this->mem->mem.data(), this->mem, budget);
+	const uint64_t retired = res >> 32;
+	this->reg->pc = res & 0xffff;
+	/* the block that ran last, not necessarily the one entered */
+	if (retired)
+		this->mem->rom_ptr = (res >> 16) & 0xffff;
+	return retired;
+}
+
+void jit_unit::invalidate(const uint16_t addr)
+{
+	/* blocks chain into each other, dropping all of them is simplest */
+	if (addr <= ROM_END && this->covered.test(addr))
+		this->flush();
+}
+
+void jit_unit::flush(void)
+{
+	std::fill(this->blocks.begin(), this->blocks.end(), jit_block());
+	std::fill(this->hits.begin(), this->hits.end(), 0);
+	std::fill(this->chain.begin(), this->chain.end(), nullptr);
+	this->covered.reset();
+
+	this->cur = this->code;
+	this->exit_stub = this->cur;
+	if (this->code)
+		this->emit_exit();
+}
+
+/* runs translated blocks where possible, interprets everything else */
+enum STOP_REASON ctrl_unit::run_jit(const uint64_t ticks)
+{
+	if (!this->jit)
+		this->jit = std::make_unique<jit_unit>(this->mem, this->reg);
+	if (!this->jit->ready())
+		return this->run_threaded(ticks);
+
+	enum STOP_REASON reason = STOP_BUDGET;
+	const bool has_bp = this->bpoints.any();
+	bool leader = true;
+	uint64_t done = 0;
+
+	while (done < ticks) {
+		const uint16_t pc = this->reg->get_pc();
+		if (has_bp && this->bpoints.test(pc) && this->at_break(pc)) {
+			reason = STOP_BREAK;
+			break;
+		}
+
+		/* only block leaders are counted and translated */
+		if (leader && pc <= ROM_END) {
+			jit_block *block = this->jit->lookup(pc, this->bpoints);
+			if (block && block->len <= ticks - done) {
+				done += this->jit->enter(block, ticks - done);
+				continue;
+			}
+		}
+
+		this->fetch();
+		if (this->decode() != E_OK || this->execute() != E_OK) {
+			reason = STOP_FAULT;
+			break;
+		}
+		done++;
+		if (this->trap) {
+			reason = this->trap;
+			break;
+		}
+		leader = (this->instr.opcode == __BEQ || this->instr.opcode == __JALR ||
+			  this->instr.opcode == __EXT);
+	}
+	/* translated code bypasses reg_unit::write */
+	this->reg->touch();
+	this->retired += done;
+	return reason;
+}
@@ -0,0 +1,78 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "modules.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <bitset>
+
+#define JIT_THRESHOLD	16		/* block entries before translation */
+#define JIT_MAX_BLOCK	64		/* guest instructions per block */
+#define JIT_CODE_SIZE	(4 << 20)	/* bytes of host code */
+
+typedef uint64_t (*jit_fn)(uint16_t *rx, uint16_t *mem, mem_unit *ctx, uint64_t budget);
+
+struct jit_block {
+	jit_fn fn = nullptr;
+	uint16_t len = 0;	/* guest instructions */
+	uint16_t last = 0;	/* address of the final instruction */
+};
+
+/* x86-64 basic block translator for ROM code
+ *
+ * guest r1-r7 live in host registers while translated code runs, r0 is
+ * folded into constants. blocks jump straight into each other through the
+ * chain table until the budget runs out or the next $pc has no block, then
+ * return the next $pc in the low half of the result and the number of
+ * retired instructions in the high half */
+class jit_unit {
+private:
+	/* private members BEGIN */
+	mem_unit *mem = nullptr;
+	reg_unit *reg = nullptr;
+
+	uint8_t *code = nullptr;
+	uint8_t *cur = nullptr;
+	uint8_t *exit_stub = nullptr;
+
+	std::vector<jit_block> blocks;
+	std::vector<uint8_t *> chain;	/* body entry past the prologue */
+	std::vector<uint16_t> hits;
+	std::bitset<ROM_END + 1> covered;
+	/* private members END */
+	/* private functions BEGIN */
+	void emit8(const uint8_t byte);
+	void emit32(const uint32_t word);
+	void emit64(const uint64_t word);
+	void rex(const bool wide, const uint8_t reg, const uint8_t rm);
+	void op_rr(const uint8_t op, const uint8_t rm, const uint8_t reg);
+	void mov_rr(const uint8_t dst, const uint8_t src);
+	void mov_ri(const uint8_t dst, const uint32_t imm);
+	void add_ri(const uint8_t dst, const uint32_t imm);
+	void movzx16(const uint8_t dst, const uint8_t src);
+	void get_greg(const uint8_t dst, const uint8_t greg);
+	void load_greg(const uint8_t dst, const uint8_t greg);
+	void store_greg(const uint8_t greg, const uint8_t src);
+	void load_mem(const uint8_t dst);
+	void push(const uint8_t reg);
+	void pop(const uint8_t reg);
+	void jump(const uint8_t cond, const uint8_t *target);
+	void emit_exit(void);
+
+	bool compile(const uint16_t start, const std::bitset<MEM_CAPACITY> &bpoints);
+	/* private functions END */
+public:
+	jit_unit(mem_unit *mem, reg_unit *reg);
+	~jit_unit(void);
+
+	bool ready(void);
+	jit_block *lookup(const uint16_t pc, const std::bitset<MEM_CAPACITY> &bpoints);
+	uint64_t enter(const jit_block *block, const uint64_t budget);
+
+	void invalidate(const uint16_t addr);
+	void flush(void);
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "live.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <chrono>
+
+live_unit::live_unit(ctrl_unit *ctrl, mem_unit *mem, reg_unit *reg)
+{
+	this->ctrl = ctrl;
+	this->mem = mem;
+	this->reg = reg;
+	for (uint8_t i = 0; i < 3; i++) {
+		this->frames[i] = std::make_unique<struct live_frame>();
+		this->stale[i].set();
+	}
+}
+
+live_unit::~live_unit(void)
+{
+	if (this->worker.joinable()) {
+		this->stop();
+		this->worker.join();
+	}
+}
+
+void live_unit::start(void)
+{
+	this->worker = std::thread(&live_unit::emulate, this);
+}
+
+/* asks the emulation thread to stop after its current slice */
+void live_unit::stop(void)
+{
+	this->cmds.push(LIVE_STOP);
+}
+
+void live_unit::join(void)
+{
+	if (this->worker.joinable())
+		this->worker.join();
+}
+
+/* the newest frame if there is one the render thread hasn't seen, stays
+ * valid until the next call */
+const struct live_frame *live_unit::latest(void)
+{
+	if (!(this->middle.load() & LIVE_FRESH))
+		return nullptr;
+	this->front = this->middle.exchange(this->front) & ~LIVE_FRESH;
+	return this->frames[this->front].get();
+}
+
+void live_unit::publish(const enum STOP_REASON reason, const bool done)
+{
+	struct live_frame &frame = *this->frames[this->back];
+
+	std::bitset<BUS_PAGES> pages;
+	this->mem->take_dirty(pages);
+	for (auto &it : this->stale)
+		it |= pages;
+	for (uint32_t page = 0; page < BUS_PAGES; page++) {
+		if (this->stale[this->back].test(page))
+			this->mem->read_block(page << BUS_PAGE_SHIFT, &frame.mem[page << BUS_PAGE_SHIFT],
+					      1 << BUS_PAGE_SHIFT);
+	}
+	this->stale[this->back].reset();
+
+	/* a frame still marked fresh was skipped, its pages carry over. one
+	 * taken after this check only makes the list longer than needed */
+	if (!(this->middle.load() & LIVE_FRESH))
+		this->unseen.reset();
+	this->unseen |= pages;
+	frame.pages = this->unseen;
+
+	frame.pc = this->reg->get_pc();
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		frame.rx[i] = this->reg->read(i);
+	frame.rom_ptr = this->mem->rom_ptr;
+	frame.ram_ptr = this->mem->ram_ptr;
+	frame.retired = this->ctrl->get_retired();
+	frame.reason = reason;
+	frame.done = done;
+
+	this->back = this->middle.exchange(this->back | LIVE_FRESH) & ~LIVE_FRESH;
+}
+
+/* runs in slices of POLL_TICKS, between them it looks for commands and
+ * publishes a frame once a period has passed */
+void live_unit::emulate(void)
+{
+	const auto period = std::chrono::microseconds(1000000 / LIVE_FPS);
+	auto next = std::chrono::steady_clock::now();
+	enum STOP_REASON reason = STOP_BUDGET;
+	enum LIVE_CMD cmd;
+
+	while (reason == STOP_BUDGET) {
+		if (this->cmds.pop(cmd) && cmd == LIVE_STOP)
+			break;
+		reason = this->ctrl->run(POLL_TICKS);
+
+		const auto now = std::chrono::steady_clock::now();
+		if (now >= next) {
+			this->publish(STOP_BUDGET, false);
+			next = now + period;
+		}
+	}
+	this->publish(reason, true);
+}
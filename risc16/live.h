@@ -0,0 +1,73 @@
+#ifndef LIVE_H
+#define LIVE_H
+
+#include "modules.h"
+#include "cmdi.h"
+#include "spsc.h"
+
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <memory>
+#include <thread>
+
+#define LIVE_FPS	30	/* frames published and drawn per second */
+#define LIVE_QUEUE	16	/* commands in flight to the emulation thread */
+#define LIVE_FRESH	4	/* set on the middle buffer until it is taken */
+
+enum LIVE_CMD {
+	LIVE_STOP	= 0
+};
+
+/* machine state as the render thread sees it */
+struct live_frame {
+	uint16_t pc = 0;
+	uint16_t rx[N_OF_REGS] = { 0 };
+	uint16_t rom_ptr = 0;
+	uint16_t ram_ptr = 0;
+	uint64_t retired = 0;
+	enum STOP_REASON reason = STOP_BUDGET;
+	bool done = false;	/* the last frame of the run */
+	std::bitset<BUS_PAGES> pages;	/* stored to since the render thread last took a frame */
+	std::array<uint16_t, MEM_CAPACITY> mem;
+};
+
+/* runs the machine on its own thread until it stops or is told to. frames
+ * go out through a triple buffer: the emulation thread fills the back one
+ * and swaps it with the middle, the render thread swaps the middle with its
+ * front one when LIVE_FRESH says there is something new. only bus pages
+ * stored to since a buffer was last filled are copied into it again, and
+ * a frame lists the pages the render thread hasn't seen change yet */
+class live_unit {
+private:
+	/* private members BEGIN */
+	ctrl_unit *ctrl = nullptr;
+	mem_unit *mem = nullptr;
+	reg_unit *reg = nullptr;
+
+	std::thread worker;
+	spsc_queue<enum LIVE_CMD, LIVE_QUEUE> cmds;
+
+	std::unique_ptr<struct live_frame> frames[3];
+	std::bitset<BUS_PAGES> stale[3];	/* emulation thread only */
+	std::bitset<BUS_PAGES> unseen;		/* emulation thread only */
+	uint8_t back = 0;			/* emulation thread only */
+	uint8_t front = 1;			/* render thread only */
+	std::atomic<uint8_t> middle = 2;
+	/* private members END */
+	/* private functions BEGIN */
+	void emulate(void);
+	void publish(const enum STOP_REASON reason, const bool done);
+	/* private functions END */
+public:
+	live_unit(ctrl_unit *ctrl, mem_unit *mem, reg_unit *reg);
+	~live_unit(void);
+
+	void start(void);
+	void stop(void);
+	void join(void);
+	const struct live_frame *latest(void);
+};
+
+#endif
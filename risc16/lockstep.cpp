@@ -0,0 +1,276 @@
+#include "lockstep.h"
+#include "cond.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+/* x86-64-v4 brings AVX-512BW, one clone per vector width */
+#if defined(__x86_64__)
+#define LOCKSTEP_CLONES	__attribute__((target_clones("arch=x86-64-v4", "avx2", "default")))
+#else
+#define LOCKSTEP_CLONES
+#endif
+
+static const uint32_t LANES = LOCKSTEP_LANES;
+
+/* lane_vec is wider than the baseline ABI passes in registers, so nothing
+ * takes or returns it by value */
+#define SPLAT(x)		(lane_vec{} + static_cast<uint16_t>(x))
+/* lanes of mask take a, the rest keep b */
+#define SELECT(mask, a, b)	(((a) & (mask)) | ((b) & ~(mask)))
+
+static inline bool none(const lane_vec &v)
+{
+	uint64_t words[sizeof(v) / sizeof(uint64_t)];
+	memcpy(words, &v, sizeof(v));
+	uint64_t acc = 0;
+	for (auto const& word : words)
+		acc |= word;
+	return !acc;
+}
+
+lockstep_unit::lockstep_unit(void)
+{
+	this->mem.assign(MEM_CAPACITY * LANES, 0);
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		this->rx[i] = SPLAT(0);
+	this->pc = SPLAT(0);
+	this->active = SPLAT(0);
+	for (uint32_t lane = 0; lane < LANES; lane++) {
+		this->retired[lane] = 0;
+		this->reason[lane] = STOP_NONE;
+	}
+}
+
+/* lanes that are never loaded stay idle and report STOP_NONE */
+void lockstep_unit::load(const uint32_t lane, const uint16_t *image, const uint16_t pc, const uint16_t *rx)
+{
+	for (uint32_t addr = 0; addr < MEM_CAPACITY; addr++)
+		this->mem[addr * LANES + lane] = image[addr];
+	for (uint16_t i = 1; i < N_OF_REGS; i++)
+		this->rx[i][lane] = rx[i];
+	this->pc[lane] = pc;
+	this->active[lane] = 0xffff;
+	this->retired[lane] = 0;
+	this->reason[lane] = STOP_NONE;
+}
+
+/* every lane stops on the same terms as ctrl_unit::run(ticks): before a
+ * breakpoint or after ticks instructions. lanes that ran in lockstep only
+ * bump base, extra counts the steps a lane took on its own */
+LOCKSTEP_CLONES
+void lockstep_unit::run(const uint64_t ticks, const std::bitset<MEM_CAPACITY> &bpoints,
+			const std::map<uint16_t, struct bp_cond> &conds)
+{
+	uint64_t base = 0;
+	uint64_t extra[LANES] = { 0 };
+	uint64_t max_extra = 0;
+	bool known = false;
+	uint16_t at = 0;
+	instr_t in;
+
+	if (!ticks) {
+		for (uint32_t lane = 0; lane < LANES; lane++) {
+			if (this->active[lane])
+				this->reason[lane] = STOP_BUDGET;
+		}
+		this->active = SPLAT(0);
+	}
+
+	while (!none(this->active)) {
+		if (!known) {
+			at = UINT16_MAX;
+			for (uint32_t lane = 0; lane < LANES; lane++) {
+				if (this->active[lane] && this->pc[lane] < at)
+					at = this->pc[lane];
+			}
+		}
+
+		/* lanes at the lowest pc that hold the same word there */
+		lane_vec mask = this->active & (lane_vec)(this->pc == SPLAT(at));
+		lane_vec row;
+		memcpy(&row, &this->mem[at * LANES], sizeof(row));
+		uint32_t lead = 0;
+		while (!mask[lead])
+			lead++;
+		const uint16_t word = row[lead];
+		mask &= (lane_vec)(row == SPLAT(word));
+
+		/* a condition is checked per lane, lanes where it fails run on */
+		if (bpoints.test(at)) {
+			auto const cond = conds.find(at);
+			lane_vec hit = mask;
+			for (uint32_t lane = 0; lane < LANES; lane++) {
+				if (!mask[lane])
+					continue;
+				if (cond != conds.end()) {
+					uint16_t rx[N_OF_REGS];
+					for (uint16_t i = 0; i < N_OF_REGS; i++)
+						rx[i] = this->rx[i][lane];
+					if (!cond_eval(cond->second.code, rx, at, &this->mem[lane], LANES)) {
+						hit[lane] = 0;
+						continue;
+					}
+				}
+				this->reason[lane] = STOP_BREAK;
+				this->retired[lane] = base + extra[lane];
+			}
+			this->active &= ~hit;
+			mask &= ~hit;
+			known = false;
+			if (none(mask))
+				continue;
+			lead = 0;
+			while (!mask[lead])
+				lead++;
+		}
+		const bool converged = none(mask ^ this->active);
+
+		if (in.decode(word) != E_OK) {
+			for (uint32_t lane = 0; lane < LANES; lane++) {
+				if (!mask[lane])
+					continue;
+				this->reason[lane] = STOP_FAULT;
+				this->retired[lane] = base + extra[lane];
+			}
+			this->active &= ~mask;
+			known = false;
+			continue;
+		}
+
+		const uint16_t next = at + 1;
+		lane_vec next_pc = SPLAT(next);
+		enum STOP_REASON trap = STOP_NONE;
+		uint16_t addr;
+		switch (in.opcode) {
+		case __ADD:
+			if (in.rA)
+				this->rx[in.rA] = SELECT(mask, this->rx[in.rB] + this->rx[in.rC], this->rx[in.rA]);
+			break;
+		case __ADDI:
+			if (in.rA)
+				this->rx[in.rA] = SELECT(mask, this->rx[in.rB] + in.imm, this->rx[in.rA]);
+			break;
+		case __NAND:
+			if (in.rA)
+				this->rx[in.rA] = SELECT(mask, ~(this->rx[in.rB] & this->rx[in.rC]), this->rx[in.rA]);
+			break;
+		case __LUI:
+			if (in.rA)
+				this->rx[in.rA] = SELECT(mask, SPLAT((in.imm << 6) & MASK_LUI), this->rx[in.rA]);
+			break;
+		case __SW:
+			for (uint32_t lane = 0; lane < LANES; lane++) {
+				addr = in.imm + this->rx[in.rB][lane];
+				if (mask[lane] && addr >= RAM_START && addr < RAM_END)
+					this->mem[addr * LANES + lane] = this->rx[in.rA][lane];
+			}
+			break;
+		case __LW:
+			if (!in.rA)
+				break;
+			for (uint32_t lane = 0; lane < LANES; lane++) {
+				addr = in.imm + this->rx[in.rB][lane];
+				if (mask[lane])
+					this->rx[in.rA][lane] = this->mem[addr * LANES + lane];
+			}
+			break;
+		case __BEQ:
+			next_pc = SELECT((lane_vec)(this->rx[in.rA] == this->rx[in.rB]),
+					 SPLAT(static_cast<uint16_t>(next + in.imm)), next_pc);
+			break;
+		case __JALR:
+			/* rB is read before rA is written */
+			next_pc = this->rx[in.rB];
+			if (in.rA)
+				this->rx[in.rA] = SELECT(mask, SPLAT(next), this->rx[in.rA]);
+			break;
+		case __EXT:
+			/* no host handlers here, other syscalls do nothing */
+			if ((in.imm >> 4) == EXT_EXCEPTION)
+				trap = ((in.imm & 0xf) == EXC_HALT) ? STOP_HALT : STOP_FAULT;
+			else if ((in.imm & 0xf) == SYS_EXIT)
+				trap = STOP_HALT;
+			if (trap)
+				next_pc = SPLAT(at);
+			break;
+
+		default:
+			break;
+		};
+		this->pc = SELECT(mask, next_pc, this->pc);
+
+		if (converged) {
+			base++;
+		} else {
+			for (uint32_t lane = 0; lane < LANES; lane++) {
+				if (mask[lane])
+					max_extra = std::max(max_extra, ++extra[lane]);
+			}
+		}
+
+		if (trap) {
+			for (uint32_t lane = 0; lane < LANES; lane++) {
+				if (!mask[lane])
+					continue;
+				this->reason[lane] = trap;
+				this->retired[lane] = base + extra[lane];
+			}
+			this->active &= ~mask;
+			known = false;
+			continue;
+		}
+
+		/* the next pc is known without a scan while every lane agrees */
+		known = converged;
+		if (known && (in.opcode == __BEQ || in.opcode == __JALR)) {
+			at = this->pc[lead];
+			known = none(this->active & (lane_vec)(this->pc != SPLAT(at)));
+		} else if (known) {
+			at = next;
+		}
+
+		if (base + max_extra < ticks)
+			continue;
+		max_extra = 0;
+		for (uint32_t lane = 0; lane < LANES; lane++) {
+			if (!this->active[lane])
+				continue;
+			if (base + extra[lane] >= ticks) {
+				this->reason[lane] = STOP_BUDGET;
+				this->retired[lane] = base + extra[lane];
+				this->active[lane] = 0;
+				known = false;
+			} else {
+				max_extra = std::max(max_extra, extra[lane]);
+			}
+		}
+	}
+}
+
+uint16_t lockstep_unit::read(const uint32_t lane, const uint16_t addr)
+{
+	return this->mem[addr * LANES + lane];
+}
+
+uint16_t lockstep_unit::read_reg(const uint32_t lane, const uint16_t reg)
+{
+	return (reg < N_OF_REGS) ? this->rx[reg][lane] : 0;
+}
+
+uint16_t lockstep_unit::get_pc(const uint32_t lane)
+{
+	return this->pc[lane];
+}
+
+uint64_t lockstep_unit::get_retired(const uint32_t lane)
+{
+	return this->retired[lane];
+}
+
+enum STOP_REASON lockstep_unit::get_reason(const uint32_t lane)
+{
+	return this->reason[lane];
+}
@@ -0,0 +1,53 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "modules.h"
+#include "cmdi.h"
+
+#include <cstdint>
+#include <bitset>
+#include <map>
+#include <vector>
+
+/* machines per group: 8, 16 or 32 lanes of 16 bits fill an SSE, AVX2 or
+ * AVX-512 register */
+#define LOCKSTEP_LANES	16
+
+static_assert(LOCKSTEP_LANES == 8 || LOCKSTEP_LANES == 16 || LOCKSTEP_LANES == 32,
+	      "LOCKSTEP_LANES must be 8, 16 or 32");
+
+typedef uint16_t lane_vec __attribute__((vector_size(LOCKSTEP_LANES * sizeof(uint16_t))));
+
+/* LOCKSTEP_LANES machines in struct-of-arrays form. each step runs the
+ * instruction at the lowest pc among running lanes for every lane sitting
+ * there with the same word; add/addi/nand/lui/beq/jalr are vector ops under
+ * that lane mask, lw/sw go lane by lane */
+class lockstep_unit {
+private:
+	/* private members BEGIN */
+	/* word addr * LOCKSTEP_LANES + lane, so one pc is one vector load */
+	std::vector<uint16_t> mem;
+
+	lane_vec rx[N_OF_REGS];
+	lane_vec pc;
+	lane_vec active;	/* 0xffff for lanes still running */
+
+	uint64_t retired[LOCKSTEP_LANES];
+	enum STOP_REASON reason[LOCKSTEP_LANES];
+	/* private members END */
+public:
+	lockstep_unit(void);
+	~lockstep_unit(void) = default;
+
+	void load(const uint32_t lane, const uint16_t *image, const uint16_t pc, const uint16_t *rx);
+	void run(const uint64_t ticks, const std::bitset<MEM_CAPACITY> &bpoints,
+		 const std::map<uint16_t, struct bp_cond> &conds);
+
+	uint16_t read(const uint32_t lane, const uint16_t addr);
+	uint16_t read_reg(const uint32_t lane, const uint16_t reg);
+	uint16_t get_pc(const uint32_t lane);
+	uint64_t get_retired(const uint32_t lane);
+	enum STOP_REASON get_reason(const uint32_t lane);
+};
+
+#endif
@@ -1,26 +1,535 @@
 #include "cmdi.h"
+#include "undo.h"
+#include "console.h"
+#include "fleet.h"
+#include "timing.h"
+#include "cache.h"
+#include "gdb.h"
+#include "diff.h"
+#include "live.h"
+#include "winpos.h"
 #include "gen-err.h"
 
 #include <iostream>
 #include <cstring>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <getopt.h>
 #include <ncurses.h>
 
-#define TERMX_MIN 100
+#define TERMX_MIN (X_SCANIN + IOBUF_SIZE - 1)	/* the scan line is the widest row */
 #define TERMY_MIN 24
 static const char *TERMERR_SMALL = "Terminal too small!";
 
+static const char *USAGE =
+	"Usage:\t./main [options] <object-file>\n"
+	"\t./main --fuzz N --diff ENGINE [options]\n"
+	"\t-H, --headless\t\trun without the ncurses UI and print statistics\n"
+	"\t-n, --max-instr N\tstop after N instructions (headless)\n"
+	"\t-b, --break ADDR\tstop at hex address ADDR, may be repeated\n"
+	"\t-e, --engine NAME\texecution core: switch (default), threaded or jit\n"
+	"\t-o, --save-image FILE\twrite the loaded program as a binary image and exit\n"
+	"\t-L, --load-snapshot FILE\trestore a machine snapshot before running\n"
+	"\t-S, --save-snapshot FILE\tsave a machine snapshot when the run stops (headless)\n"
+	"\t-C, --console FILE\twrite stdout device output to FILE instead of the screen\n"
+	"\t-i, --idle\t\tstop headless and fleet runs stuck in a loop that can never exit\n"
+	"\t\t\t\t(always on interactive, not with --lockstep)\n"
+	"\t-F, --fleet FILE\trun one headless machine per line of FILE (hex ADDR=DATA pokes)\n"
+	"\t-j, --jobs N\t\tfleet worker threads (default: one per core)\n"
+	"\t-l, --lockstep\t\trun fleet cases in SIMD groups\n"
+	"\t-d, --dump START:END\tinclude hex memory range in the fleet report, may be repeated\n"
+	"\t-P, --profile FILE\twrite a flat profile to FILE and folded stacks to FILE.folded\n"
+	"\t-M, --timing FILE	write 5-stage pipeline cycle counts and hazards per pc to FILE\n"
+	"\t-R, --timing-rules LIST	comma separated: [no-]forward, resolve-id|resolve-ex, [no-]predict\n"
+	"\t\t\t\t(default: forward,resolve-ex,predict)\n"
+	"\t-c, --cache FILE	write L1 I/D cache hit and miss rates per pc and per page to FILE\n"
+	"\t-I, --icache SPEC	I-cache as SIZE:WAYS:LINE[:lru|fifo|random], sizes in words\n"
+	"\t-D, --dcache SPEC	D-cache, same format (default for both: 1024:2:8:lru)\n"
+	"\t-x, --diff ENGINE\tcompare --engine against ENGINE every 64 instructions (needs --max-instr)\n"
+	"\t-z, --fuzz N\t\tcompare the two engines on N random programs, no object file\n"
+	"\t-s, --seed N\t\tfirst fuzz seed (default: 1)\n"
+	"\t-g, --gdb PORT|PATH\tserve the gdb remote protocol on a localhost TCP port or unix socket\n"
+	"\t-T, --trace FILE\trecord a binary execution trace, see trace-dump\n"
+	"\t-U, --undo N\t\tkeep N instructions of undo history, 0 disables\n"
+	"\t\t\t\t(default: 1048576 interactive, off headless)\n";
+
+static const struct option LONG_OPTS[] = {
+	{ "headless",	no_argument,		nullptr, 'H' },
+	{ "max-instr",	required_argument,	nullptr, 'n' },
+	{ "break",	required_argument,	nullptr, 'b' },
+	{ "engine",	required_argument,	nullptr, 'e' },
+	{ "save-image",	required_argument,	nullptr, 'o' },
+	{ "load-snapshot",	required_argument,	nullptr, 'L' },
+	{ "save-snapshot",	required_argument,	nullptr, 'S' },
+	{ "console",	required_argument,	nullptr, 'C' },
+	{ "idle",	no_argument,		nullptr, 'i' },
+	{ "fleet",	required_argument,	nullptr, 'F' },
+	{ "jobs",	required_argument,	nullptr, 'j' },
+	{ "lockstep",	no_argument,		nullptr, 'l' },
+	{ "dump",	required_argument,	nullptr, 'd' },
+	{ "profile",	required_argument,	nullptr, 'P' },
+	{ "timing",	required_argument,	nullptr, 'M' },
+	{ "timing-rules",	required_argument,	nullptr, 'R' },
+	{ "cache",	required_argument,	nullptr, 'c' },
+	{ "icache",	required_argument,	nullptr, 'I' },
+	{ "dcache",	required_argument,	nullptr, 'D' },
+	{ "diff",	required_argument,	nullptr, 'x' },
+	{ "fuzz",	required_argument,	nullptr, 'z' },
+	{ "seed",	required_argument,	nullptr, 's' },
+	{ "gdb",	required_argument,	nullptr, 'g' },
+	{ "trace",	required_argument,	nullptr, 'T' },
+	{ "undo",	required_argument,	nullptr, 'U' },
+	{ nullptr,	0,			nullptr, 0 }
+};
+
+struct run_opts {
+	bool headless = false;
+	uint64_t max_instr = UINT64_MAX;
+	enum ENGINE engine = ENG_SWITCH;
+	std::vector<uint16_t> bpoints;
+	const char *save_image = nullptr;
+	const char *load_snapshot = nullptr;
+	const char *save_snapshot = nullptr;
+	const char *console = nullptr;
+	bool idle = false;
+	const char *fleet = nullptr;
+	unsigned jobs = 0;
+	bool lockstep = false;
+	std::vector<struct fleet_range> dumps;
+	const char *profile = nullptr;
+	const char *timing = nullptr;
+	struct timing_rules rules;
+	const char *cache = nullptr;
+	struct cache_config icache;
+	struct cache_config dcache;
+	bool diff = false;
+	enum ENGINE diff_engine = ENG_JIT;
+	uint32_t fuzz = 0;
+	uint32_t seed = 1;
+	const char *gdb = nullptr;
+	const char *trace = nullptr;
+	size_t undo = SIZE_MAX;	/* SIZE_MAX picks the mode default */
+};
+
+static enum GEN_ERR parse_opts(int argc, char **argv, struct run_opts &opts)
+{
+	uint64_t num;
+	int opt;
+	while ((opt = getopt_long(argc, argv, "Hn:b:e:o:L:S:C:iF:j:ld:P:M:R:c:I:D:x:z:s:g:T:U:", LONG_OPTS, nullptr)) != -1) {
+		switch (opt) {
+		case 'H':
+			opts.headless = true;
+			break;
+		case 'n':
+			if (str2num(optarg, 0, UINT64_MAX, num) != E_OK)
+				return E_ARG;
+			opts.max_instr = num;
+			break;
+		case 'b':
+			if (str2num(optarg, 16, UINT16_MAX, num) != E_OK)
+				return E_ARG;
+			opts.bpoints.push_back(num);
+			break;
+		case 'e':
+			if (str2engine(optarg, opts.engine) != E_OK)
+				return E_ARG;
+			break;
+		case 'o':
+			opts.save_image = optarg;
+			break;
+		case 'L':
+			opts.load_snapshot = optarg;
+			break;
+		case 'S':
+			opts.save_snapshot = optarg;
+			break;
+		case 'C':
+			opts.console = optarg;
+			break;
+		case 'i':
+			opts.idle = true;
+			break;
+		case 'F':
+			opts.fleet = optarg;
+			break;
+		case 'j':
+			if (str2num(optarg, 0, UINT_MAX, num) != E_OK)
+				return E_ARG;
+			opts.jobs = num;
+			break;
+		case 'l':
+			opts.lockstep = true;
+			break;
+		case 'd': {
+			struct fleet_range range;
+			if (str2range(optarg, range) != E_OK)
+				return E_ARG;
+			opts.dumps.push_back(range);
+			break;
+		}
+		case 'P':
+			opts.profile = optarg;
+			break;
+		case 'M':
+			opts.timing = optarg;
+			break;
+		case 'R':
+			if (str2rules(optarg, opts.rules) != E_OK)
+				return E_ARG;
+			break;
+		case 'c':
+			opts.cache = optarg;
+			break;
+		case 'I':
+			if (str2cache(optarg, opts.icache) != E_OK)
+				return E_ARG;
+			break;
+		case 'D':
+			if (str2cache(optarg, opts.dcache) != E_OK)
+				return E_ARG;
+			break;
+		case 'x':
+			if (str2engine(optarg, opts.diff_engine) != E_OK)
+				return E_ARG;
+			opts.diff = true;
+			break;
+		case 'z':
+			if (str2num(optarg, 0, UINT32_MAX, num) != E_OK)
+				return E_ARG;
+			opts.fuzz = num;
+			break;
+		case 's':
+			if (str2num(optarg, 0, UINT32_MAX, num) != E_OK)
+				return E_ARG;
+			opts.seed = num;
+			break;
+		case 'g':
+			opts.gdb = optarg;
+			break;
+		case 'T':
+			opts.trace = optarg;
+			break;
+		case 'U':
+			if (str2num(optarg, 0, SIZE_MAX, num) != E_OK)
+				return E_ARG;
+			opts.undo = num;
+			break;
+
+		default:
+			return E_ARG;
+		};
+	}
+	return E_OK;
+}
+
+/* host side of sys N, output goes wherever the stdout device goes */
+static void set_syscalls(ctrl_unit &control, console_unit &console, const bool headless)
+{
+	control.set_syscall(SYS_PUTC, [&console](const uint16_t arg) {
+		console.put(arg);
+		return arg;
+	});
+	control.set_syscall(SYS_PUTN, [&console](const uint16_t arg) {
+		for (auto const& c : std::to_string(arg))
+			console.put(c);
+		return arg;
+	});
+	/* the terminal belongs to ncurses unless headless */
+	control.set_syscall(SYS_GETC, [headless](const uint16_t arg) {
+		const int c = headless ? std::cin.get() : EOF;
+		return static_cast<uint16_t>((c == EOF) ? 0xffff : c);
+	});
+	control.set_syscall(SYS_TIME, [](const uint16_t arg) {
+		auto now = std::chrono::system_clock::now().time_since_epoch();
+		return static_cast<uint16_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+	});
+}
+
+/* copies what a frame changed into the units the panes are drawn from */
+static void show_frame(mem_unit &view, reg_unit &regs, const struct live_frame &frame)
+{
+	uint16_t words[1 << BUS_PAGE_SHIFT];
+	for (uint32_t page = 0; page < BUS_PAGES; page++) {
+		if (!frame.pages.test(page))
+			continue;
+
+		const uint32_t base = page << BUS_PAGE_SHIFT;
+		view.read_block(base, words, 1 << BUS_PAGE_SHIFT);
+		for (uint32_t i = 0; i < (1 << BUS_PAGE_SHIFT); i++) {
+			if (words[i] != frame.mem[base + i])
+				view.write(base + i, frame.mem[base + i], true);
+		}
+	}
+	view.rom_ptr = frame.rom_ptr;
+	view.ram_ptr = frame.ram_ptr;
+
+	for (uint16_t i = 1; i < N_OF_REGS; i++) {
+		if (regs.read(i) != frame.rx[i])
+			regs.write(i, frame.rx[i]);
+	}
+	regs.set_pc(frame.pc);
+}
+
+/* run to a breakpoint with the machine on its own thread. this thread
+ * only draws frames, scrolls the panes and turns any other key into a stop
+ * command, it never touches the running units */
+static void run_live(ctrl_unit &control, mem_unit &memory, reg_unit &registers, console_unit &console)
+{
+	std::vector<uint16_t> words(MEM_CAPACITY);
+	auto view = std::make_unique<mem_unit>();
+	reg_unit regs = reg_unit();
+
+	view->reset();
+	view->set_track(true);
+	memory.read_block(0, words.data(), MEM_CAPACITY);
+	view->write_block(0, words.data(), MEM_CAPACITY);
+	view->set_rom_beginp(memory.get_rom_beginp());
+	view->set_rom_endp(memory.get_rom_beginp() + VIEW_MEM_RANGE);
+	view->set_ram_beginp(memory.get_ram_beginp());
+	view->set_ram_endp(memory.get_ram_beginp() + VIEW_MEM_RANGE);
+	regs.reset();
+
+	/* the instruction text and breakpoint marks can't be drawn live */
+	clear();
+	view->touch();
+	regs.touch();
+	console.touch();
+	console.set_async(true);
+
+	live_unit live(&control, &memory, &registers);
+	const uint64_t start = control.get_retired();
+	auto begin = std::chrono::steady_clock::now();
+	enum STOP_REASON reason = STOP_BUDGET;
+	bool stopping = false;
+	char buf[IOBUF_SIZE];
+
+	live.start();
+	for (;;) {
+		/* a program printing fast shouldn't wait a whole frame for room */
+		timeout(console.drain() ? 1 : 1000 / LIVE_FPS);
+		const int key = getch();
+		switch (key) {
+		case ERR:
+			break;
+		case 'u':
+			view->dec_rom_ptr();
+			break;
+		case 'j':
+			view->inc_rom_ptr();
+			break;
+		case 'i':
+			view->dec_ram_ptr();
+			break;
+		case 'k':
+			view->inc_ram_ptr();
+			break;
+		case KEY_RESIZE:
+			clear();
+			view->touch();
+			regs.touch();
+			console.touch();
+			break;
+
+		default:
+			if (!stopping)
+				live.stop();
+			stopping = true;
+			break;
+		};
+
+		const struct live_frame *frame = live.latest();
+		if (frame) {
+			show_frame(*view, regs, *frame);
+			const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			const uint64_t done = frame->retired - start;
+			snprintf(buf, sizeof(buf), "run: %llu, %.1f MIPS", static_cast<unsigned long long>(done),
+				 (secs > 0) ? done / secs / 1e6 : 0);
+			mvprintw(Y_SCANIN - 1, X_SCANIN, "%-*s", IOBUF_SIZE - 1, buf);
+		}
+		if (frame || key != ERR) {
+			view->draw();
+			regs.draw();
+			console.draw();
+			refresh();
+		}
+
+		if (frame && frame->done) {
+			reason = frame->reason;
+			break;
+		}
+	}
+	timeout(-1);
+
+	/* the worker has published its last frame and is about to exit */
+	live.join();
+	console.set_async(false);
+	memory.set_rom_beginp(view->get_rom_beginp());
+	memory.set_rom_endp(view->get_rom_beginp() + VIEW_MEM_RANGE);
+	memory.set_ram_beginp(view->get_ram_beginp());
+	memory.set_ram_endp(view->get_ram_beginp() + VIEW_MEM_RANGE);
+	control.report_stop(reason);
+}
+
+static int run_headless(ctrl_unit &control, reg_unit &registers, console_unit &console,
+			const struct run_opts &opts)
+{
+	auto start = std::chrono::steady_clock::now();
+	enum STOP_REASON reason = control.run(opts.max_instr);
+	auto end = std::chrono::steady_clock::now();
+	console.flush();
+
+	double secs = std::chrono::duration<double>(end - start).count();
+	uint64_t retired = control.get_retired();
+	double mips = (secs > 0) ? retired / secs / 1e6 : 0;
+
+	std::cout << "stop: " << stop2str(reason) << "\n";
+	if (reason == STOP_HALT)
+		std::cout << "exit: " << control.get_exit_code() << "\n";
+	else if (reason == STOP_FAULT && control.get_exc() != EXC_NONE)
+		std::cout << "exception: " << static_cast<unsigned>(control.get_exc()) << "\n";
+	std::cout << "retired: " << retired << "\n";
+	std::cout << "time: " << secs << " s\n";
+	std::cout << "MIPS: " << mips << "\n";
+	if (opts.timing) {
+		const uint64_t cycles = control.get_cycles();
+		std::cout << "cycles: " << cycles << "\n";
+		std::cout << "CPI: " << (retired ? static_cast<double>(cycles) / retired : 0) << "\n";
+	}
+	registers.print(std::cout);
+
+	if (opts.save_snapshot && control.save_snapshot(opts.save_snapshot) != E_OK) {
+		std::cerr << "ERR " << E_IO << ": can't save snapshot \"" << opts.save_snapshot << "\"\n";
+		return E_IO;
+	}
+
+	/* batch scripts see the guest's exit code */
+	if (reason == STOP_HALT)
+		return control.get_exit_code() & 0xff;
+	return (reason == STOP_FAULT) ? E_RANGE : E_OK;
+}
+
+static int run_gdb(ctrl_unit &control, mem_unit &memory, reg_unit &registers,
+		   console_unit &console, const struct run_opts &opts)
+{
+	enum GEN_ERR retval = E_OK;
+	gdb_unit gdb(&control, &memory, &registers);
+	if ((retval = gdb.listen(opts.gdb)) != E_OK) {
+		std::cerr << "ERR " << retval << ": can't listen on \"" << opts.gdb << "\"\n";
+		return retval;
+	}
+	retval = gdb.serve();
+	console.flush();
+	return retval;
+}
+
+static int run_diff(mem_unit &memory, reg_unit &registers, const struct run_opts &opts)
+{
+	enum GEN_ERR retval = E_OK;
+	struct diff_opts dopts;
+	dopts.engines[0] = opts.engine;
+	dopts.engines[1] = opts.diff_engine;
+	dopts.budget = opts.max_instr;
+
+	if (opts.fuzz) {
+		if (dopts.budget == UINT64_MAX)
+			dopts.budget = FUZZ_BUDGET;
+		return diff_fuzz(dopts, opts.fuzz, opts.seed, std::cout);
+	}
+	if (dopts.budget == UINT64_MAX) {
+		retval = E_ARG;
+		std::cerr << "ERR " << retval << ": diff runs need --max-instr\n";
+		return retval;
+	}
+
+	std::vector<uint16_t> image(MEM_CAPACITY);
+	uint16_t rx[N_OF_REGS];
+	memory.read_block(0, image.data(), MEM_CAPACITY);
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		rx[i] = registers.read(i);
+
+	diff_unit diff(dopts);
+	diff.load(image.data(), registers.get_pc(), rx);
+	if ((retval = diff.run(std::cout)) == E_OK)
+		std::cout << "no divergence in " << diff.get_retired() << " instructions\n";
+	return retval;
+}
+
+/* cases start from the loaded machine, breakpoints and conditions from
+ * --break and --load-snapshot included */
+static int run_fleet(ctrl_unit &control, mem_unit &memory, reg_unit &registers, const struct run_opts &opts)
+{
+	enum GEN_ERR retval = E_OK;
+	if (opts.max_instr == UINT64_MAX && control.get_bpoints().none()) {
+		retval = E_ARG;
+		std::cerr << "ERR " << retval << ": fleet runs need --max-instr or --break\n";
+		return retval;
+	}
+
+	struct fleet_opts fopts;
+	fopts.engine = opts.engine;
+	fopts.budget = opts.max_instr;
+	fopts.bpoints = control.get_bpoints();
+	fopts.conds = control.get_conds();
+	fopts.ranges = opts.dumps;
+	fopts.threads = opts.jobs;
+	fopts.lockstep = opts.lockstep;
+	fopts.idle = opts.idle;
+	if (fopts.idle && fopts.lockstep) {
+		retval = E_ARG;
+		std::cerr << "ERR " << retval << ": --idle does not work with --lockstep\n";
+		return retval;
+	}
+
+	fleet_unit fleet(&memory, &registers, fopts);
+	if ((retval = fleet.load_cases(opts.fleet)) != E_OK)
+		return retval;
+	fleet.run();
+	fleet.report(std::cout);
+	return retval;
+}
+
 int main(int argc, char **argv)
 {
-	if (argc != 2) {
+	struct run_opts opts;
+	if (parse_opts(argc, argv, opts) != E_OK) {
+		std::cerr << "ERR " << E_ARG << ": bad option\n";
+		std::cerr << USAGE;
+		return E_ARG;
+	}
+	if (opts.fuzz) {
+		if (!opts.diff) {
+			std::cerr << "ERR " << E_ARG << ": --fuzz needs --diff\n";
+			return E_ARG;
+		}
+		mem_unit memory = mem_unit();
+		reg_unit registers = reg_unit();
+		return run_diff(memory, registers, opts);
+	}
+	if (optind != argc - 1) {
 		std::cerr << "ERR " << E_ARG << ": no file given\n";
-		std::cerr << "Usage:\t./main <object-file>\n";
+		std::cerr << USAGE;
 		return E_ARG;
 	}
-	
+
 	mem_unit memory = mem_unit();
 	memory.reset();
-	if (memory.fill(argv[1]) != E_OK)
+
+	console_unit console = console_unit();
+	const enum SINK sink = opts.console ? SINK_FILE : (opts.headless ? SINK_STDOUT : SINK_PANE);
+	if (console.open(sink, opts.console) != E_OK) {
+		std::cerr << "ERR " << E_IO << ": can't open console \"" << opts.console << "\"\n";
 		return E_IO;
+	}
+	console.attach(&memory);
+
+	if (memory.fill(argv[optind]) != E_OK)
+		return E_IO;
+	if (opts.save_image)
+		return memory.save_image(opts.save_image);
 
 	reg_unit registers = reg_unit();
 	registers.reset();
@@ -29,6 +538,76 @@ int main(int argc, char **argv)
 	if (control.set_mem(&memory) != E_OK || control.set_reg(&registers) != E_OK)
 		return E_IO;
 
+	if (opts.load_snapshot && control.load_snapshot(opts.load_snapshot) != E_OK) {
+		std::cerr << "ERR " << E_IO << ": can't load snapshot \"" << opts.load_snapshot << "\"\n";
+		return E_IO;
+	}
+	for (auto const& it : opts.bpoints)
+		control.add_bpoint(it);
+	control.set_engine(opts.engine);
+	set_syscalls(control, console, opts.headless);
+	control.set_idle(opts.idle || !opts.headless);
+	if (opts.undo == SIZE_MAX)
+		opts.undo = opts.headless ? 0 : UNDO_DEPTH;
+	control.set_undo(opts.undo);
+	if (opts.trace && control.set_trace(opts.trace) != E_OK) {
+		std::cerr << "ERR " << E_IO << ": can't open trace \"" << opts.trace << "\"\n";
+		return E_IO;
+	}
+	if (opts.profile)
+		control.set_profile(opts.profile);
+	if (opts.timing)
+		control.set_timing(opts.timing, opts.rules);
+	if (opts.cache)
+		control.set_caches(opts.cache, opts.icache, opts.dcache);
+
+	if (opts.fleet)
+		return run_fleet(control, memory, registers, opts);
+	if (opts.diff)
+		return run_diff(memory, registers, opts);
+	if (opts.gdb) {
+		int retval = run_gdb(control, memory, registers, console, opts);
+		if (control.save_trace() != E_OK) {
+			std::cerr << "ERR " << E_IO << ": can't write trace \"" << opts.trace << "\"\n";
+			retval = E_IO;
+		}
+		if (control.save_profile() != E_OK) {
+			std::cerr << "ERR " << E_IO << ": can't write profile \"" << opts.profile << "\"\n";
+			retval = E_IO;
+		}
+		if (control.save_timing() != E_OK) {
+			std::cerr << "ERR " << E_IO << ": can't write timing \"" << opts.timing << "\"\n";
+			retval = E_IO;
+		}
+		if (control.save_caches() != E_OK) {
+			std::cerr << "ERR " << E_IO << ": can't write cache report \"" << opts.cache << "\"\n";
+			retval = E_IO;
+		}
+		return retval;
+	}
+
+	if (opts.headless) {
+		int retval = run_headless(control, registers, console, opts);
+		if (control.save_trace() != E_OK) {
+			std::cerr << "ERR " << E_IO << ": can't write trace \"" << opts.trace << "\"\n";
+			retval = E_IO;
+		}
+		if (control.save_profile() != E_OK) {
+			std::cerr << "ERR " << E_IO << ": can't write profile \"" << opts.profile << "\"\n";
+			retval = E_IO;
+		}
+		if (control.save_timing() != E_OK) {
+			std::cerr << "ERR " << E_IO << ": can't write timing \"" << opts.timing << "\"\n";
+			retval = E_IO;
+		}
+		if (control.save_caches() != E_OK) {
+			std::cerr << "ERR " << E_IO << ": can't write cache report \"" << opts.cache << "\"\n";
+			retval = E_IO;
+		}
+		return retval;
+	}
+
+	memory.set_track(true);
 	initscr();
 	noecho();
 	curs_set(FALSE);
@@ -36,12 +615,15 @@ int main(int argc, char **argv)
 
 	size_t scrx, scry;
 	uint32_t key = '.';
+	/* everything is repainted only after a clear, otherwise just what changed */
+	bool full = true;
 	do {
 		getmaxyx(stdscr, scry, scrx);
 		if (scrx < TERMX_MIN || scry < TERMY_MIN) {
 			clear();
 			mvprintw(scry / 2, scrx / 2 - strlen(TERMERR_SMALL) / 2, TERMERR_SMALL);
 			refresh();
+			full = true;
 			continue;
 		}
 
@@ -60,29 +642,58 @@ int main(int argc, char **argv)
 			break;
 		case 'r':
 			registers.reset();
+			control.clear_history();
 			break;
 		case '\n':
 			control.getline();
 			control.parseio();
+			full = true;
 			break;
 		case '.':
-			control.fetch();
-			control.decode();
-			control.execute();
+			control.step();
 			break;
 		case ',':
-			control.cmd_exetobreak();
+			run_live(control, memory, registers, console);
+			full = true;
+			break;
+		case KEY_RESIZE:
+			full = true;
 			break;
 		};
 
-		clear();
+		if (full) {
+			clear();
+			memory.touch();
+			registers.touch();
+			control.touch();
+			console.touch();
+			full = false;
+		}
 		memory.draw();
 		registers.draw();
+		console.draw();
 		control.draw();
 		refresh();
 
 	} while ( (key = getch()) != 'q');
 	endwin();
+	console.flush();
 
+	if (control.save_trace() != E_OK) {
+		std::cerr << "ERR " << E_IO << ": can't write trace \"" << opts.trace << "\"\n";
+		return E_IO;
+	}
+	if (control.save_profile() != E_OK) {
+		std::cerr << "ERR " << E_IO << ": can't write profile \"" << opts.profile << "\"\n";
+		return E_IO;
+	}
+	if (control.save_timing() != E_OK) {
+		std::cerr << "ERR " << E_IO << ": can't write timing \"" << opts.timing << "\"\n";
+		return E_IO;
+	}
+	if (control.save_caches() != E_OK) {
+		std::cerr << "ERR " << E_IO << ": can't write cache report \"" << opts.cache << "\"\n";
+		return E_IO;
+	}
 	return E_OK;
-}
\ No newline at end of file
+}
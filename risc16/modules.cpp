@@ -1,14 +1,17 @@
 #include "modules.h"
+#include "cmdi.h"
+#include "image.h"
 #include "winpos.h"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cctype>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
 #include <ncurses.h>
 
-static const uint32_t STDOUT_W = 32;
-static const uint32_t STDOUT_H = 8;
-
 /* memory unit interface BEGIN */
 void mem_unit::reset(void)
 {
@@ -20,10 +23,29 @@ void mem_unit::reset(void)
 	this->ram_beginp = RAM_START;
 	this->ram_endp = RAM_START + VIEW_MEM_RANGE;
 
+	/* devices stay mapped across resets */
+	for (uint32_t page = 0; page < BUS_PAGES; page++) {
+		if (this->page_type[page] != PAGE_DEV)
+			this->page_type[page] = ((page << BUS_PAGE_SHIFT) <= ROM_END) ? PAGE_ROM : PAGE_RAM;
+	}
+
 	this->mem.fill(0);
+	this->redraw = true;
+	if (this->ctrl)
+		this->ctrl->flush_dcache();
 }
 
+/* loads a binary image or, failing the magic check, a hex text file */
 enum GEN_ERR mem_unit::fill(const char *path)
+{
+	enum GEN_ERR retval = is_image(path) ? this->fill_image(path) : this->fill_text(path);
+	this->redraw = true;
+	if (this->ctrl)
+		this->ctrl->flush_dcache();
+	return retval;
+}
+
+enum GEN_ERR mem_unit::fill_text(const char *path)
 {
 	enum GEN_ERR retval = E_OK;
 
@@ -35,8 +57,27 @@ enum GEN_ERR mem_unit::fill(const char *path)
 		return retval;
 	}
 
-	uint16_t addr = 0;
-	while (getline(prog, line) && addr < ROM_END) {
+	this->symbols.clear();
+	uint32_t addr = ROM_START;
+	while (getline(prog, line)) {
+		/* ":addr name" lines from the assembler name an address, they hold no data */
+		if (!line.empty() && line[0] == ':') {
+			std::stringstream sym(line.substr(1));
+			std::string hex, name;
+			uint64_t at = 0;
+			if (!(sym >> hex >> name) || str2num(hex.c_str(), 16, 0xffff, at) != E_OK) {
+				retval = E_IO;
+				std::cerr << "ERR " << retval << ": invalid symbol {" << line << "}\n";
+				return retval;
+			}
+			this->symbols[at] = name;
+			continue;
+		}
+		if (addr > ROM_END) {
+			retval = E_RANGE;
+			std::cerr << "ERR " << retval << ": program doesn't fit into ROM (0x" << std::hex << ROM_END + 1 << std::dec << " words)\n";
+			return retval;
+		}
 		uint32_t data = 0;
 		try {
 			data = std::stoi(line, nullptr, 16);
@@ -61,6 +102,109 @@ enum GEN_ERR mem_unit::fill(const char *path)
 	return retval;
 }
 
+void mem_unit::set_ctrl(ctrl_unit *ctrl)
+{
+	this->ctrl = ctrl;
+}
+
+/* devices live in RAM; the pages they touch lose the direct fast path */
+enum GEN_ERR mem_unit::map_device(const uint16_t start, const uint16_t end,
+				  dev_read_fn read, dev_write_fn write)
+{
+	if (start < RAM_START || end < start)
+		return E_RANGE;
+
+	this->devices.push_back({ start, end, read, write });
+	for (uint32_t page = start >> BUS_PAGE_SHIFT; page <= (end >> BUS_PAGE_SHIFT); page++)
+		this->page_type[page] = PAGE_DEV;
+	if (read) {
+		this->dev_reads = true;
+		/* translated loads were emitted without the device check */
+		if (this->ctrl)
+			this->ctrl->flush_dcache();
+	}
+	return E_OK;
+}
+
+void mem_unit::set_mute(const bool muted)
+{
+	this->muted = muted;
+}
+
+bool mem_unit::is_muted(void)
+{
+	return this->muted;
+}
+
+bool mem_unit::is_device(const uint16_t addr)
+{
+	return this->page_type[addr >> BUS_PAGE_SHIFT] == PAGE_DEV;
+}
+
+/* watchpoints sit on RAM words and outlive resets like devices do */
+enum GEN_ERR mem_unit::add_watch(const uint16_t addr, const uint8_t kind)
+{
+	if (addr < RAM_START)
+		return E_RANGE;
+	if (!kind || (kind & ~WATCH_RW))
+		return E_ARG;
+
+	if (!this->watch[addr])
+		this->watched++;
+	this->watch[addr] |= kind;
+	this->page_watch[addr >> BUS_PAGE_SHIFT] |= kind;
+	return E_OK;
+}
+
+enum GEN_ERR mem_unit::del_watch(const uint16_t addr, const uint8_t kind)
+{
+	if (!(this->watch[addr] & kind))
+		return E_ARG;
+
+	this->watch[addr] &= ~kind;
+	if (!this->watch[addr])
+		this->watched--;
+
+	/* the page keeps whatever its other words still need */
+	const uint32_t page = addr >> BUS_PAGE_SHIFT;
+	const uint32_t start = page << BUS_PAGE_SHIFT;
+	this->page_watch[page] = WATCH_NONE;
+	for (uint32_t at = start; at < start + (1 << BUS_PAGE_SHIFT); at++)
+		this->page_watch[page] |= this->watch[at];
+	return E_OK;
+}
+
+bool mem_unit::is_watched(void)
+{
+	return this->watched;
+}
+
+/* the control unit stops once the accessing instruction has retired */
+void mem_unit::hit_watch(const uint16_t addr, const uint8_t kind)
+{
+	if ((this->watch[addr] & kind) && !this->muted && this->ctrl)
+		this->ctrl->hit_watch(addr, kind);
+}
+
+uint16_t mem_unit::read_device(const uint16_t addr)
+{
+	for (auto const& dev : this->devices) {
+		if (addr >= dev.start && addr <= dev.end && dev.read)
+			return dev.read(addr);
+	}
+	return this->mem[addr];
+}
+
+void mem_unit::write_device(const uint16_t addr, const uint16_t data)
+{
+	if (this->muted)
+		return;
+	for (auto const& dev : this->devices) {
+		if (addr >= dev.start && addr <= dev.end && dev.write)
+			dev.write(addr, data);
+	}
+}
+
 void mem_unit::inc_rom_ptr(void)
 {
 	if (this->rom_endp < ROM_END) {
@@ -138,74 +282,120 @@ const uint16_t mem_unit::get_ram_endp(void)
 // technically unsafe
 uint16_t mem_unit::read(const uint16_t addr)
 {
+	if (this->page_watch[addr >> BUS_PAGE_SHIFT] & WATCH_R)
+		this->hit_watch(addr, WATCH_R);
+	if (this->dev_reads && this->page_type[addr >> BUS_PAGE_SHIFT] == PAGE_DEV)
+		return this->read_device(addr);
 	return this->mem[addr];
 }
 
 enum GEN_ERR mem_unit::write(const uint16_t addr, const uint16_t data, const bool force)
 {
 	enum GEN_ERR retval = E_OK;
-	if (addr >= ROM_START && addr <= ROM_END) {
-		if (force) {
-			this->mem[addr] = data;
-		} else {
+	if (this->page_watch[addr >> BUS_PAGE_SHIFT] & WATCH_W)
+		this->hit_watch(addr, WATCH_W);
+	switch (this->page_type[addr >> BUS_PAGE_SHIFT]) {
+	case PAGE_ROM:
+		if (!force) {
 			retval = E_ROMAC;
 			return retval;
 		}
-	}
-	if (addr >= RAM_START && addr <= RAM_END) {
-		this->mem[addr] = data;
-	}
+		break;
+	case PAGE_DEV:
+		this->write_device(addr, data);
+		break;
+
+	default:
+		break;
+	};
+
+	this->mem[addr] = data;
+	if (this->track)
+		this->dirty.set(addr >> BUS_PAGE_SHIFT);
+	if (this->ctrl)
+		this->ctrl->invalidate(addr);
 	return retval;
 }
 
-void mem_unit::__draw_memseg(const uint32_t ypos, const uint32_t xpos, const uint16_t start, const uint16_t end, const uint16_t pos)
+/* raw copies for snapshots, stores skip the ROM check */
+void mem_unit::read_block(const uint16_t addr, uint16_t *buf, const uint32_t words)
+{
+	std::copy_n(this->mem.begin() + addr, words, buf);
+}
+
+void mem_unit::write_block(const uint16_t addr, const uint16_t *buf, const uint32_t words)
+{
+	std::copy_n(buf, words, this->mem.begin() + addr);
+	this->redraw = true;
+	if (this->ctrl)
+		this->ctrl->flush_dcache();
+}
+
+/* stores are only tracked for the panes and for take_dirty, headless runs
+ * leave it off */
+void mem_unit::set_track(const bool on)
 {
-	attron(A_STANDOUT);
-	mvprintw(ypos, xpos, "@0x%04x-0x%04x", start, end);
-	attroff(A_STANDOUT);
+	this->track = on;
+	this->dirty.reset();
+	this->redraw = true;
+}
+
+/* hands the stored-to pages over, the panes then miss them and repaint
+ * fully on their next draw */
+void mem_unit::take_dirty(std::bitset<BUS_PAGES> &pages)
+{
+	if (this->dirty.none())
+		return;
+	pages |= this->dirty;
+	this->dirty.reset();
+	this->redraw = true;
+}
+
+/* only lines on a page that was stored to or whose highlight moved are
+ * redrawn, unless the whole pane is */
+void mem_unit::__draw_memseg(const uint32_t ypos, const uint32_t xpos, const uint16_t start, const uint16_t end,
+			     const uint16_t pos, const uint16_t old_pos, const bool full)
+{
+	if (full) {
+		attron(A_STANDOUT);
+		mvprintw(ypos, xpos, "@0x%04x-0x%04x", start, end);
+		attroff(A_STANDOUT);
+	}
 	uint32_t addr, offset;
 	for (addr = start, offset = 1; addr <= end; addr++, offset++) {
+		if (!full && !this->dirty.test(addr >> BUS_PAGE_SHIFT) && addr != pos && addr != old_pos)
+			continue;
 		if (addr == pos)
 			attron(A_BOLD);
 
-		if (isprint(this->mem[addr]) && isascii(this->mem[addr])) {
-			mvprintw(ypos + offset, xpos, " 0x%04x 0x%04x: %c", addr, this->mem[addr], this->mem[addr]);
-		} else {
-			mvprintw(ypos + offset, xpos, " 0x%04x 0x%04x:", addr, this->mem[addr]);
-		}
+		/* same width either way so a stale character never survives */
+		const uint16_t data = this->mem[addr];
+		const char c = (isprint(data) && isascii(data)) ? data : ' ';
+		mvprintw(ypos + offset, xpos, " 0x%04x 0x%04x: %c", addr, data, c);
 		attroff(A_BOLD);
 	}
 }
 
-static void rectangle(uint32_t y1, uint32_t x1, uint32_t y2, uint32_t x2)
+/* forces the next draw to repaint everything, e.g. after clear() */
+void mem_unit::touch(void)
 {
-	mvhline(y1, x1, ACS_HLINE, x2 - x1);
-	mvhline(y2, x1, ACS_HLINE, x2 - x1);
-	mvvline(y1, x1, ACS_VLINE, y2 - y1);
-	mvvline(y1, x2, ACS_VLINE, y2 - y1);
-	mvaddch(y1, x1, ACS_ULCORNER);
-	mvaddch(y2, x1, ACS_LLCORNER);
-	mvaddch(y1, x2, ACS_URCORNER);
-	mvaddch(y2, x2, ACS_LRCORNER);
+	this->redraw = true;
 }
 
 void mem_unit::draw(void)
 {
-	this->__draw_memseg(Y_ROM, X_ROM, this->rom_beginp, this->rom_endp, this->rom_ptr);
-	this->__draw_memseg(Y_RAM, X_RAM, this->ram_beginp, this->ram_endp, this->ram_ptr);
-	/* draw stdout */
-	attron(A_BOLD);
-	rectangle(Y_STDOUT - 1, X_STDOUT - 1, Y_STDOUT + STDOUT_H,
-		  X_STDOUT + STDOUT_W);
-	attroff(A_BOLD);
-	for (uint32_t i = 0; i < STDOUT_H; i++) {
-		for (uint32_t j = 0; j < STDOUT_W; j++) {
-			uint16_t index = STDOUT_START + (STDOUT_W * i + j);
-
-			if (isprint(this->mem[index]))
-				mvaddch(Y_STDOUT + i, X_STDOUT + j, this->mem[index]);
-		}
-	}
+	const bool full = this->redraw;
+	this->__draw_memseg(Y_ROM, X_ROM, this->rom_beginp, this->rom_endp, this->rom_ptr,
+			    this->drawn_rom_ptr, full || this->rom_beginp != this->drawn_rom);
+	this->__draw_memseg(Y_RAM, X_RAM, this->ram_beginp, this->ram_endp, this->ram_ptr,
+			    this->drawn_ram_ptr, full || this->ram_beginp != this->drawn_ram);
+
+	this->dirty.reset();
+	this->redraw = false;
+	this->drawn_rom = this->rom_beginp;
+	this->drawn_ram = this->ram_beginp;
+	this->drawn_rom_ptr = this->rom_ptr;
+	this->drawn_ram_ptr = this->ram_ptr;
 }
 /* memory unit interface END */
 
@@ -214,6 +404,7 @@ void reg_unit::reset(void)
 {
 	this->pc = 0;
 	this->rx.fill(0);
+	this->touch();
 }
 
 void reg_unit::inc_pc(void)
@@ -243,14 +434,39 @@ void reg_unit::write(const uint16_t reg, const uint16_t data)
 		return;
 	else
 	 	this->rx[reg] = data;
+	this->dirty |= 1 << reg;
+}
+
+/* the threaded and translated cores write rx directly and call this */
+void reg_unit::touch(void)
+{
+	this->dirty = REG_DIRTY_ALL;
 }
 
 void reg_unit::draw(void)
 {
-	mvprintw(Y_REGS, X_REGS, "REGISTERS:");
+	/* the title only needs drawing after a clear */
+	if (this->dirty & REG_DIRTY_TITLE)
+		mvprintw(Y_REGS, X_REGS, "REGISTERS:");
+	for (int i = 0; i < N_OF_REGS; i++) {
+		if (this->dirty & (1 << i))
+			mvprintw(Y_REGS + i + 1, X_REGS, "$R%d: 0x%04x", i, this->rx[i]);
+	}
+	if ((this->dirty & REG_DIRTY_TITLE) || this->pc != this->drawn_pc)
+		mvprintw(Y_REGS + N_OF_REGS + 1, X_REGS, "$PC: 0x%04x", this->pc);
+
+	this->dirty = 0;
+	this->drawn_pc = this->pc;
+}
+
+void reg_unit::print(std::ostream &os)
+{
+	char buf[16];
 	for (int i = 0; i < N_OF_REGS; i++) {
-		mvprintw(Y_REGS + i + 1, X_REGS, "$R%d: 0x%04x", i, this->rx[i]);
+		snprintf(buf, sizeof(buf), "$R%d: 0x%04x\n", i, this->rx[i]);
+		os << buf;
 	}
-	mvprintw(Y_REGS + N_OF_REGS + 1, X_REGS, "$PC: 0x%04x", this->pc);
+	snprintf(buf, sizeof(buf), "$PC: 0x%04x\n", this->pc);
+	os << buf;
 }
 /* register unit interface END */
\ No newline at end of file
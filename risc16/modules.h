@@ -1,8 +1,16 @@
+#ifndef MODULES_H
+#define MODULES_H
+
 #include "gen-err.h"
 
 #include <cstdint>
 #include <string>
 #include <array>
+#include <map>
+#include <bitset>
+#include <vector>
+#include <functional>
+#include <ostream>
 
 #define N_OF_REGS	8
 #define MEM_CAPACITY	65536
@@ -13,10 +21,48 @@
 #define RAM_START	0x2000
 #define RAM_END		0xffff
 
+/* reg_unit dirty bits past the registers themselves */
+#define REG_DIRTY_TITLE	(1 << N_OF_REGS)
+#define REG_DIRTY_ALL	((1 << (N_OF_REGS + 1)) - 1)
+
 #define STDOUT_START	0x2000
 #define STDOUT_END	0x20ff
 
+/* the bus decides per page whether an access can touch mem[] directly */
+#define BUS_PAGE_SHIFT	8
+#define BUS_PAGES	(MEM_CAPACITY >> BUS_PAGE_SHIFT)
+
+enum PAGE_TYPE {
+	PAGE_ROM	= 0,
+	PAGE_RAM	= 1,
+	PAGE_DEV	= 2	/* at least one device overlaps the page */
+};
+
+/* watchpoint kinds, a page holds the union of its words' kinds */
+enum WATCH_TYPE {
+	WATCH_NONE	= 0,
+	WATCH_R		= 1,
+	WATCH_W		= 2,
+	WATCH_RW	= 3
+};
+
+typedef std::function<uint16_t(const uint16_t addr)> dev_read_fn;
+typedef std::function<void(const uint16_t addr, const uint16_t data)> dev_write_fn;
+
+/* memory-mapped device: stores still land in mem[] and are then passed on,
+ * loads come from read when it is set */
+struct bus_device {
+	uint16_t start;
+	uint16_t end;	/* inclusive */
+	dev_read_fn read;
+	dev_write_fn write;
+};
+
+class ctrl_unit;
+
 class mem_unit {
+	/* translated code addresses the memory array directly */
+	friend class jit_unit;
 private:
 	/* private members BEGIN */
 	uint16_t rom_beginp;
@@ -25,11 +71,45 @@ private:
 	uint16_t ram_endp;
 
 	std::array<uint16_t, MEM_CAPACITY> mem;
+
+	/* notified of every store so it can drop stale decodes */
+	ctrl_unit *ctrl = nullptr;
+
+	/* address -> label, from the symbol section of a binary image */
+	std::map<uint16_t, std::string> symbols;
+
+	/* page types and the devices behind PAGE_DEV pages */
+	std::array<uint8_t, BUS_PAGES> page_type = {};
+	std::vector<struct bus_device> devices;
+	bool dev_reads = false;	/* some device intercepts loads */
+	bool muted = false;	/* replays must not repeat device output */
+
+	/* watched RAM words, loads and stores only look at them on pages
+	 * whose page_watch has that kind */
+	std::array<uint8_t, MEM_CAPACITY> watch = {};
+	std::array<uint8_t, BUS_PAGES> page_watch = {};
+	uint32_t watched = 0;
+
+	/* pages stored to since the last draw while something draws or
+	 * takes them, and what the panes showed then */
+	std::bitset<BUS_PAGES> dirty;
+	bool track = false;
+	bool redraw = true;
+	uint16_t drawn_rom = 0;
+	uint16_t drawn_ram = 0;
+	uint16_t drawn_rom_ptr = 0;
+	uint16_t drawn_ram_ptr = 0;
 	/* private members END */
 	/* private functions BEGIN */
+	enum GEN_ERR fill_text(const char *path);
+	enum GEN_ERR fill_image(const char *path);
+	uint16_t read_device(const uint16_t addr);
+	void write_device(const uint16_t addr, const uint16_t data);
+	void hit_watch(const uint16_t addr, const uint8_t kind);
 	void __draw_memseg(const uint32_t xpos, const uint32_t ypos,
 			   const uint16_t start, const uint16_t end,
-			   const uint16_t pos);
+			   const uint16_t pos, const uint16_t old_pos,
+			   const bool full);
 	/* private functions END */
 public:
 	/* public members BEGIN */
@@ -42,6 +122,17 @@ public:
 
 	void reset(void);
 	enum GEN_ERR fill(const char *path);
+	enum GEN_ERR save_image(const char *path);
+	const std::map<uint16_t, std::string> &get_symbols(void);
+	void set_ctrl(ctrl_unit *ctrl);
+	enum GEN_ERR map_device(const uint16_t start, const uint16_t end,
+				dev_read_fn read, dev_write_fn write);
+	void set_mute(const bool muted);
+	bool is_muted(void);
+	bool is_device(const uint16_t addr);
+	enum GEN_ERR add_watch(const uint16_t addr, const uint8_t kind);
+	enum GEN_ERR del_watch(const uint16_t addr, const uint8_t kind);
+	bool is_watched(void);
 
 	void inc_rom_ptr(void);
 	void dec_rom_ptr(void);
@@ -58,16 +149,28 @@ public:
 
 	uint16_t read(const uint16_t addr);
 	enum GEN_ERR write(const uint16_t addr, const uint16_t data, bool force);
+	void read_block(const uint16_t addr, uint16_t *buf, const uint32_t words);
+	void write_block(const uint16_t addr, const uint16_t *buf, const uint32_t words);
+	void set_track(const bool on);
+	void take_dirty(std::bitset<BUS_PAGES> &pages);
 
+	void touch(void);
 	void draw(void);
 	/* public functions END */
 };
 
 class reg_unit {
+	/* the threaded core and translated code use the register file directly */
+	friend class ctrl_unit;
+	friend class jit_unit;
 private:
 	/* private members BEGIN */
 	uint16_t pc;
 	std::array<uint16_t, N_OF_REGS> rx;
+
+	/* bit per register written since the last draw */
+	uint16_t dirty = REG_DIRTY_ALL;
+	uint16_t drawn_pc = 0;
 	/* private members END */
 public:
 	reg_unit(void) = default;
@@ -82,5 +185,9 @@ public:
 	uint16_t read(const uint16_t reg);
 	void write(const uint16_t reg, const uint16_t data);
 
+	void touch(void);
 	void draw(void);
-};
\ No newline at end of file
+	void print(std::ostream &os);
+};
+
+#endif
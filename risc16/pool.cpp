@@ -0,0 +1,66 @@
+#include "pool.h"
+
+#include <thread>
+
+work_pool::work_pool(const unsigned threads)
+{
+	const unsigned n = threads ? threads : 1;
+	for (unsigned i = 0; i < n; i++)
+		this->queues.push_back(std::make_unique<struct task_queue>());
+}
+
+unsigned work_pool::size(void)
+{
+	return this->queues.size();
+}
+
+bool work_pool::pop(const size_t self, size_t &task)
+{
+	struct task_queue &q = *this->queues[self];
+	std::lock_guard<std::mutex> guard(q.lock);
+	if (q.tasks.empty())
+		return false;
+	task = q.tasks.back();
+	q.tasks.pop_back();
+	return true;
+}
+
+bool work_pool::steal(const size_t self, size_t &task)
+{
+	const size_t n = this->queues.size();
+	for (size_t i = 1; i < n; i++) {
+		struct task_queue &q = *this->queues[(self + i) % n];
+		std::lock_guard<std::mutex> guard(q.lock);
+		if (q.tasks.empty())
+			continue;
+		task = q.tasks.front();
+		q.tasks.pop_front();
+		return true;
+	}
+	return false;
+}
+
+/* tasks are dealt out in contiguous runs so neighbours share a worker; no
+ * task spawns more, so a worker that finds every deque empty is done */
+void work_pool::run(const size_t n_tasks, const std::function<void(const size_t task)> &fn)
+{
+	const size_t n = this->queues.size();
+	for (size_t i = 0; i < n; i++) {
+		const size_t begin = n_tasks * i / n;
+		const size_t end = n_tasks * (i + 1) / n;
+		/* reversed so pop() from the back walks the run in order */
+		for (size_t task = end; task > begin; task--)
+			this->queues[i]->tasks.push_back(task - 1);
+	}
+
+	std::vector<std::thread> workers;
+	for (size_t self = 0; self < n; self++) {
+		workers.emplace_back([this, self, &fn] {
+			size_t task;
+			while (this->pop(self, task) || this->steal(self, task))
+				fn(task);
+		});
+	}
+	for (auto &worker : workers)
+		worker.join();
+}
@@ -0,0 +1,35 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* fixed set of worker threads, each with its own task deque: workers take
+ * from the back of their own deque and steal from the front of the others
+ * once it runs dry */
+class work_pool {
+private:
+	/* private members BEGIN */
+	struct task_queue {
+		std::mutex lock;
+		std::deque<size_t> tasks;
+	};
+	std::vector<std::unique_ptr<struct task_queue>> queues;
+	/* private members END */
+	/* private functions BEGIN */
+	bool pop(const size_t self, size_t &task);
+	bool steal(const size_t self, size_t &task);
+	/* private functions END */
+public:
+	work_pool(const unsigned threads);
+	~work_pool(void) = default;
+
+	unsigned size(void);
+	void run(const size_t n_tasks, const std::function<void(const size_t task)> &fn);
+};
+
+#endif
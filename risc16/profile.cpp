@@ -0,0 +1,160 @@
+#include "profile.h"
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <fstream>
+
+static const char *OPNAMES[PROFILE_OPS] = { "add", "addi", "nand", "lui", "sw", "lw", "beq", "jalr", "ext" };
+
+profile_unit::profile_unit(mem_unit *mem, const char *path, const uint16_t entry)
+{
+	this->mem = mem;
+	this->path = std::string(path);
+	this->pc_count.assign(MEM_CAPACITY, 0);
+
+	this->parent.push_back(0);
+	this->func.push_back(entry);
+	this->samples.push_back(0);
+}
+
+/* called for every jalr before it executes */
+void profile_unit::jump(const uint16_t pc, const uint16_t target, const bool link)
+{
+	if (!this->stack.empty() && this->stack.back().ret == target) {
+		this->node = this->stack.back().node;
+		this->stack.pop_back();
+		return;
+	}
+	if (!link || this->stack.size() >= PROFILE_DEPTH)
+		return;
+
+	this->stack.push_back({ this->node, static_cast<uint16_t>(pc + 1) });
+	const auto key = std::make_pair(this->node, target);
+	auto it = this->children.find(key);
+	if (it == this->children.end()) {
+		it = this->children.emplace(key, this->func.size()).first;
+		this->parent.push_back(this->node);
+		this->func.push_back(target);
+		this->samples.push_back(0);
+	}
+	this->node = it->second;
+}
+
+/* label at addr, or the closest label before it plus an offset */
+std::string profile_unit::name(const uint16_t addr, const bool exact)
+{
+	char buf[16];
+	const auto &symbols = this->mem->get_symbols();
+	auto it = symbols.upper_bound(addr);
+	if (it != symbols.begin()) {
+		it--;
+		if (it->first == addr)
+			return it->second;
+		if (!exact) {
+			snprintf(buf, sizeof(buf), "+%u", addr - it->first);
+			return it->second + buf;
+		}
+	}
+	if (!exact)
+		return std::string();
+	snprintf(buf, sizeof(buf), "0x%04x", addr);
+	return std::string(buf);
+}
+
+/* writes the flat profile to path and folded stacks to path.folded */
+enum GEN_ERR profile_unit::save(void)
+{
+	std::ofstream flat(this->path, std::ios::trunc);
+	std::ofstream folded(this->path + ".folded", std::ios::trunc);
+	if (!flat.is_open() || !folded.is_open())
+		return E_IO;
+
+	char line[128];
+	const double total = this->total ? this->total : 1;
+	snprintf(line, sizeof(line), "# %llu instructions retired\n\n",
+		 static_cast<unsigned long long>(this->total));
+	flat << line;
+
+	flat << "#  opcode           count       %\n";
+	for (uint8_t op = 0; op < PROFILE_OPS; op++) {
+		snprintf(line, sizeof(line), "   %-6s %14llu %6.2f\n", OPNAMES[op],
+			 static_cast<unsigned long long>(this->op_count[op]), 100.0 * this->op_count[op] / total);
+		flat << line;
+	}
+
+	std::vector<uint16_t> hot;
+	for (uint32_t pc = 0; pc < MEM_CAPACITY; pc++) {
+		if (this->pc_count[pc])
+			hot.push_back(pc);
+	}
+	std::stable_sort(hot.begin(), hot.end(), [this](uint16_t a, uint16_t b) {
+		return this->pc_count[a] > this->pc_count[b];
+	});
+
+	flat << "\n#           count       %      pc    word  instruction\n";
+	for (auto const& pc : hot) {
+		snprintf(line, sizeof(line), "  %14llu %6.2f  ",
+			 static_cast<unsigned long long>(this->pc_count[pc]), 100.0 * this->pc_count[pc] / total);
+		flat << line;
+
+		const std::string text = disasm_at(this->mem, pc);
+		const std::string label = this->name(pc, false);
+		if (label.empty()) {
+			flat << text << "\n";
+		} else {
+			snprintf(line, sizeof(line), "%-38s", text.c_str());
+			flat << line << label << "\n";
+		}
+	}
+
+	/* one line per call chain: caller;callee;... count */
+	for (uint32_t id = 0; id < this->samples.size(); id++) {
+		if (!this->samples[id])
+			continue;
+
+		std::vector<uint32_t> chain;
+		for (uint32_t at = id; ; at = this->parent[at]) {
+			chain.push_back(at);
+			if (!at)
+				break;
+		}
+		for (auto it = chain.rbegin(); it != chain.rend(); it++) {
+			if (it != chain.rbegin())
+				folded << ";";
+			folded << this->name(this->func[*it], true);
+		}
+		folded << " " << this->samples[id] << "\n";
+	}
+
+	return (flat && folded) ? E_OK : E_IO;
+}
+
+/* control unit profiling BEGIN */
+enum GEN_ERR ctrl_unit::set_profile(const char *path)
+{
+	if (!path) {
+		this->profile.reset();
+		return E_OK;
+	}
+	this->profile = std::make_unique<profile_unit>(this->mem, path, this->reg->get_pc());
+	return E_OK;
+}
+
+enum GEN_ERR ctrl_unit::save_profile(void)
+{
+	if (!this->profile)
+		return E_OK;
+	return this->profile->save();
+}
+
+void ctrl_unit::profile_instr(void)
+{
+	const uint16_t pc = this->reg->get_pc();
+	this->profile->count(pc, this->instr.opcode);
+	if (this->instr.opcode == __JALR)
+		this->profile->jump(pc, this->reg->read(this->instr.rB), this->instr.rA != 0);
+}
+/* control unit profiling END */
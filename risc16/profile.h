@@ -0,0 +1,61 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "modules.h"
+#include "cmdi.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#define PROFILE_DEPTH	256	/* deepest call chain that is followed */
+#define PROFILE_OPS	(__EXT + 1)
+
+/* one function on the shadow call stack */
+struct prof_frame {
+	uint32_t node;	/* call tree node the caller was in */
+	uint16_t ret;	/* address the callee is expected to return to */
+};
+
+/* execution counts per pc and per opcode, plus a call tree built from jalr:
+ * a jalr back to the return address on top of the shadow stack is a
+ * return, any other jalr with a link register is a call */
+class profile_unit {
+private:
+	/* private members BEGIN */
+	mem_unit *mem = nullptr;
+	std::string path;
+
+	std::vector<uint64_t> pc_count;
+	uint64_t op_count[PROFILE_OPS] = { 0 };
+	uint64_t total = 0;
+
+	/* call tree, node 0 is the entry point */
+	std::vector<uint32_t> parent;
+	std::vector<uint16_t> func;
+	std::vector<uint64_t> samples;
+	std::map<std::pair<uint32_t, uint16_t>, uint32_t> children;
+	uint32_t node = 0;
+	std::vector<struct prof_frame> stack;
+	/* private members END */
+	/* private functions BEGIN */
+	std::string name(const uint16_t addr, const bool exact);
+	/* private functions END */
+public:
+	profile_unit(mem_unit *mem, const char *path, const uint16_t entry);
+	~profile_unit(void) = default;
+
+	inline void count(const uint16_t pc, const uint8_t opcode)
+	{
+		this->pc_count[pc]++;
+		this->op_count[opcode]++;
+		this->samples[this->node]++;
+		this->total++;
+	}
+	void jump(const uint16_t pc, const uint16_t target, const bool link);
+
+	enum GEN_ERR save(void);
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "snapshot.h"
+#include "cmdi.h"
+#include "cond.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+static uint32_t fnv1a(uint32_t hash, const void *data, const size_t size)
+{
+	const uint8_t *bytes = static_cast<const uint8_t *>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static const uint32_t FNV_BASIS = 2166136261u;
+
+template <typename T>
+static void put(std::vector<uint8_t> &buf, const T *data, const size_t count)
+{
+	const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+	buf.insert(buf.end(), bytes, bytes + count * sizeof(T));
+}
+
+enum GEN_ERR ctrl_unit::save_snapshot(const char *path)
+{
+	struct snap_header hdr;
+	memcpy(hdr.magic, SNAP_MAGIC, sizeof(hdr.magic));
+	hdr.version = SNAP_VERSION;
+	hdr.pc = this->reg->get_pc();
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		hdr.rx[i] = this->reg->read(i);
+	hdr.n_pages = 0;
+	hdr.reserved = 0;
+	hdr.n_bpoints = 0;
+	hdr.checksum = 0;
+
+	std::vector<uint8_t> payload;
+	for (uint32_t addr = 0; addr < MEM_CAPACITY; addr++) {
+		if (!this->bpoints.test(addr))
+			continue;
+
+		auto const it = this->conds.find(addr);
+		const std::string cond = (it != this->conds.end()) ? it->second.src : std::string();
+		const uint16_t bp = addr;
+		const uint16_t len = std::min<size_t>(cond.size(), UINT16_MAX);
+		put(payload, &bp, 1);
+		put(payload, &len, 1);
+		put(payload, cond.data(), len);
+		hdr.n_bpoints++;
+	}
+
+	uint16_t words[SNAP_PAGE];
+	for (uint32_t page = 0; page < MEM_CAPACITY / SNAP_PAGE; page++) {
+		this->mem->read_block(page * SNAP_PAGE, words, SNAP_PAGE);
+		bool empty = true;
+		for (uint32_t i = 0; i < SNAP_PAGE && empty; i++)
+			empty = (words[i] == 0);
+		if (empty)
+			continue;
+
+		const uint16_t idx = page;
+		put(payload, &idx, 1);
+		put(payload, words, SNAP_PAGE);
+		hdr.n_pages++;
+	}
+
+	hdr.checksum = fnv1a(fnv1a(FNV_BASIS, &hdr, sizeof(hdr)), payload.data(), payload.size());
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return E_IO;
+	file.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+	file.write(reinterpret_cast<const char *>(payload.data()), payload.size());
+	return file ? E_OK : E_IO;
+}
+
+/* the file is checked completely before any state is touched */
+enum GEN_ERR ctrl_unit::load_snapshot(const char *path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return E_IO;
+	std::vector<uint8_t> buf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	struct snap_header hdr;
+	if (buf.size() < sizeof(hdr))
+		return E_IO;
+	memcpy(&hdr, buf.data(), sizeof(hdr));
+	if (memcmp(hdr.magic, SNAP_MAGIC, sizeof(hdr.magic)) || hdr.version != SNAP_VERSION)
+		return E_IO;
+
+	/* breakpoint records vary in length, walk them to find the pages */
+	size_t pos = sizeof(hdr);
+	if (hdr.n_bpoints > MEM_CAPACITY)
+		return E_RANGE;
+	for (uint32_t i = 0; i < hdr.n_bpoints; i++) {
+		uint16_t len;
+		if (buf.size() < pos + 2 * sizeof(uint16_t))
+			return E_RANGE;
+		memcpy(&len, buf.data() + pos + sizeof(uint16_t), sizeof(len));
+		pos += 2 * sizeof(uint16_t) + len;
+	}
+
+	const size_t page_size = sizeof(uint16_t) * (SNAP_PAGE + 1);
+	const size_t expected = pos + hdr.n_pages * page_size;
+	if (buf.size() != expected)
+		return E_RANGE;
+
+	const uint32_t checksum = hdr.checksum;
+	hdr.checksum = 0;
+	const uint32_t actual = fnv1a(fnv1a(FNV_BASIS, &hdr, sizeof(hdr)),
+				      buf.data() + sizeof(hdr), buf.size() - sizeof(hdr));
+	if (actual != checksum)
+		return E_IO;
+
+	const uint8_t *pages = buf.data() + pos;
+	for (uint16_t i = 0; i < hdr.n_pages; i++) {
+		uint16_t idx;
+		memcpy(&idx, pages + i * page_size, sizeof(idx));
+		if (idx >= MEM_CAPACITY / SNAP_PAGE)
+			return E_RANGE;
+	}
+
+	std::bitset<MEM_CAPACITY> bpoints;
+	std::map<uint16_t, struct bp_cond> conds;
+	pos = sizeof(hdr);
+	for (uint32_t i = 0; i < hdr.n_bpoints; i++) {
+		uint16_t bp, len;
+		memcpy(&bp, buf.data() + pos, sizeof(bp));
+		memcpy(&len, buf.data() + pos + sizeof(bp), sizeof(len));
+		pos += sizeof(bp) + sizeof(len);
+		bpoints.set(bp);
+		if (!len)
+			continue;
+
+		struct bp_cond &cond = conds[bp];
+		cond.src.assign(reinterpret_cast<const char *>(buf.data() + pos), len);
+		pos += len;
+		if (cond_compile(cond.src, this->mem->get_symbols(), cond.code) != E_OK)
+			return E_ARG;
+	}
+
+	/* commit: absent pages are zero */
+	std::vector<uint16_t> image(MEM_CAPACITY, 0);
+	for (uint16_t i = 0; i < hdr.n_pages; i++) {
+		uint16_t idx;
+		memcpy(&idx, pages + i * page_size, sizeof(idx));
+		memcpy(&image[idx * SNAP_PAGE], pages + i * page_size + sizeof(idx), SNAP_PAGE * sizeof(uint16_t));
+	}
+	/* also drops every predecoded and translated instruction */
+	this->mem->write_block(0, image.data(), MEM_CAPACITY);
+
+	for (uint16_t i = 1; i < N_OF_REGS; i++)
+		this->reg->write(i, hdr.rx[i]);
+	this->reg->set_pc(hdr.pc);
+
+	this->bpoints = bpoints;
+	this->conds = std::move(conds);
+	this->drawn_bpoints = -1;
+
+	return E_OK;
+}
@@ -0,0 +1,36 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "modules.h"
+
+#include <cstdint>
+
+/* machine snapshot, all fields in host byte order, so a snapshot only
+ * loads on a host of the same endianness
+ *
+ *	snap_header
+ *	n_bpoints of: uint16_t addr, uint16_t cond_len, char cond[cond_len]
+ *	n_pages of: uint16_t page, uint16_t words[SNAP_PAGE]
+ *
+ * cond is the source of a breakpoint condition, recompiled on load, an
+ * unconditional breakpoint has cond_len 0.
+ * only pages holding something other than zeros are stored. checksum is
+ * FNV-1a over the header (with checksum = 0) and everything after it */
+#define SNAP_MAGIC	"R16S"
+#define SNAP_VERSION	2
+#define SNAP_PAGE	256
+
+struct snap_header {
+	char magic[4];
+	uint16_t version;
+	uint16_t pc;
+	uint16_t rx[N_OF_REGS];
+	uint16_t n_pages;
+	uint16_t reserved;	/* 0 */
+	uint32_t n_bpoints;	/* every address may hold one */
+	uint32_t checksum;
+};
+
+static_assert(sizeof(struct snap_header) == 36, "snap_header must stay packed");
+
+#endif
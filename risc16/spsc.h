@@ -0,0 +1,47 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <cstddef>
+#include <array>
+#include <atomic>
+
+/* bounded lock-free ring for exactly one producer and one consumer thread.
+ * N must be a power of two, one slot stays empty to tell full from empty */
+template <typename T, size_t N>
+class spsc_queue {
+	static_assert(N && !(N & (N - 1)), "spsc_queue size must be a power of two");
+private:
+	/* private members BEGIN */
+	std::array<T, N> slots;
+	alignas(64) std::atomic<size_t> head = 0;	/* next slot to pop */
+	alignas(64) std::atomic<size_t> tail = 0;	/* next slot to push */
+	/* private members END */
+public:
+	spsc_queue(void) = default;
+	~spsc_queue(void) = default;
+
+	/* producer side, false when full */
+	bool push(const T &item)
+	{
+		const size_t at = this->tail.load(std::memory_order_relaxed);
+		const size_t next = (at + 1) & (N - 1);
+		if (next == this->head.load(std::memory_order_acquire))
+			return false;
+		this->slots[at] = item;
+		this->tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	/* consumer side, false when empty */
+	bool pop(T &item)
+	{
+		const size_t at = this->head.load(std::memory_order_relaxed);
+		if (at == this->tail.load(std::memory_order_acquire))
+			return false;
+		item = this->slots[at];
+		this->head.store((at + 1) & (N - 1), std::memory_order_release);
+		return true;
+	}
+};
+
+#endif
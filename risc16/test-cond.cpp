@@ -0,0 +1,77 @@
+#include "cond.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+struct cond_case {
+	const char *src;
+	bool expect;
+};
+
+/* $r1 = 5, $r2 = 0xfff0, pc = 0x0010, [0x3000] = 7, [0x0007] = 0x3000 */
+static const struct cond_case CASES[] = {
+	{ "r1 == 5",				true },
+	{ "$r1 != 5",				false },
+	{ "r2 > r1",				true },		/* unsigned */
+	{ "r1 + 0xfffb == 0",			true },		/* wraps at 16 bits */
+	{ "r1 - 6 == 0xffff",			true },
+	{ "-r1 == 0xfffb",			true },
+	{ "(r1 & 4) == 4 && (r1 | 2) == 7",	true },
+	{ "r1 < 5 || r1 >= 5",			true },
+	{ "r1 <= 4",				false },
+	{ "!r0",				true },
+	{ "!(r1 == 5) || r0",			false },
+	{ "pc == 0x10 && $pc == loop",		true },
+	{ "[0x3000] == 7",			true },
+	{ "[[data]] == 7",			true },		/* labels are addresses */
+	{ "[r2 + 0x3010] == r1 + 2",		true },
+	{ "r1",					true },		/* any non-zero word */
+	{ "r1 == 5 && [0x3000] > 10",		false },
+};
+
+/* each fails to compile */
+static const char *BAD[] = {
+	"", "r1 ==", "r8 == 0", "nolabel", "0x10000", "(r1", "[r1", "r1 r2", "r1 === 5",
+	"1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+1))))))))))))))))"
+};
+
+/* compiles every case against a small machine and checks the outcome */
+int main(void)
+{
+	bool ok = true;
+	mem_unit mem;
+	mem.reset();
+
+	const uint16_t words[] = { 7, 0x3000 };
+	mem.write_block(0x3000, &words[0], 1);
+	mem.write_block(0x0007, &words[1], 1);
+	const uint16_t rx[N_OF_REGS] = { 0, 5, 0xfff0 };
+	const std::map<uint16_t, std::string> symbols = { { 0x0007, "data" }, { 0x0010, "loop" } };
+
+	std::vector<uint16_t> code;
+	for (auto const& it : CASES) {
+		if (cond_compile(it.src, symbols, code) != E_OK) {
+			std::cerr << "FAIL: \"" << it.src << "\" does not compile\n";
+			ok = false;
+			continue;
+		}
+		if (cond_eval(code, rx, 0x0010, &mem) != it.expect) {
+			std::cerr << "FAIL: \"" << it.src << "\" is " << !it.expect << "\n";
+			ok = false;
+		}
+	}
+	for (auto const& src : BAD) {
+		if (cond_compile(src, symbols, code) == E_OK) {
+			std::cerr << "FAIL: \"" << src << "\" compiles\n";
+			ok = false;
+		}
+	}
+	if (!ok)
+		return 1;
+	std::cout << "condition bytecode: ok\n";
+	return 0;
+}
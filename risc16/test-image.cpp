@@ -0,0 +1,120 @@
+#include "image.h"
+#include "modules.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#define TEST_TEXT	"test-image.hex"
+#define TEST_IMAGE	"test-image.img"
+
+/* assembler output: a word per line, then a ":addr name" line per label */
+static const char *TEXT =
+	"68c0\n2900\na500\n5000\nc404\n0d81\n8d01\n0484\nc07b\ne071\n"
+	":0004 loop\n:0009 done\n";
+static const uint16_t ROM[] = { 0x68c0, 0x2900, 0xa500, 0x5000, 0xc404,
+				0x0d81, 0x8d01, 0x0484, 0xc07b, 0xe071 };
+static const std::map<uint16_t, std::string> SYMBOLS = { { 0x0004, "loop" }, { 0x0009, "done" } };
+
+static void put_file(const char *path, const std::string &data)
+{
+	std::ofstream(path, std::ios::binary | std::ios::trunc) << data;
+}
+
+/* the loader reports what it refuses, which is expected here */
+static enum GEN_ERR fill_quiet(mem_unit &mem, const char *path)
+{
+	std::streambuf *err = std::cerr.rdbuf(nullptr);
+	const enum GEN_ERR retval = mem.fill(path);
+	std::cerr.rdbuf(err);
+	return retval;
+}
+
+static bool check(mem_unit &mem, const uint16_t data, const char *what)
+{
+	bool ok = (mem.get_symbols() == SYMBOLS);
+	std::vector<uint16_t> words(MEM_CAPACITY);
+	mem.read_block(0, words.data(), MEM_CAPACITY);
+	for (uint32_t addr = 0; addr < MEM_CAPACITY; addr++) {
+		uint16_t expect = (addr < sizeof(ROM) / sizeof(ROM[0])) ? ROM[addr] : 0;
+		if (addr == RAM_START)
+			expect = data;
+		ok &= (words[addr] == expect);
+	}
+	if (!ok)
+		std::cerr << "FAIL: " << what << " doesn't hold the program and its labels\n";
+	return ok;
+}
+
+/* the text loader keeps the assembler's labels, an image saved from it
+ * loads back the same words and symbols, and damaged images are refused
+ * without touching the program already loaded */
+int main(void)
+{
+	bool ok = true;
+	const uint16_t data = 0x1234;
+
+	put_file(TEST_TEXT, TEXT);
+	mem_unit text;
+	text.reset();
+	if (text.fill(TEST_TEXT) != E_OK) {
+		std::cerr << "FAIL: load " TEST_TEXT "\n";
+		return 1;
+	}
+	ok &= check(text, 0, "the text file");
+
+	/* RAM goes into its own segment */
+	text.write_block(RAM_START, &data, 1);
+	if (text.save_image(TEST_IMAGE) != E_OK || !is_image(TEST_IMAGE)) {
+		std::cerr << "FAIL: save " TEST_IMAGE "\n";
+		return 1;
+	}
+	mem_unit image;
+	image.reset();
+	if (image.fill(TEST_IMAGE) != E_OK) {
+		std::cerr << "FAIL: load " TEST_IMAGE "\n";
+		return 1;
+	}
+	ok &= check(image, data, "the image");
+
+	std::ifstream in(TEST_IMAGE, std::ios::binary);
+	const std::string good((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+	const std::string bad[] = {
+		good.substr(0, good.size() - 1),		/* last symbol cut short */
+		good.substr(0, sizeof(struct img_header) + 4),	/* segment table cut short */
+		good.substr(0, 4) + std::string(1, good[4] ^ 0xff) + good.substr(5),	/* version */
+	};
+	for (auto const& it : bad) {
+		put_file(TEST_IMAGE, it);
+		mem_unit mem;
+		mem.reset();
+		mem.fill(TEST_TEXT);
+		if (fill_quiet(mem, TEST_IMAGE) == E_OK) {
+			std::cerr << "FAIL: loaded an image of " << it.size() << " bytes out of " << good.size() << "\n";
+			ok = false;
+		}
+		ok &= check(mem, 0, "a machine that refused an image");
+	}
+
+	put_file(TEST_TEXT, "68c0\n:zz loop\n");
+	mem_unit mem;
+	mem.reset();
+	if (fill_quiet(mem, TEST_TEXT) == E_OK) {
+		std::cerr << "FAIL: loaded a text file with a bad label line\n";
+		ok = false;
+	}
+	std::remove(TEST_TEXT);
+	std::remove(TEST_IMAGE);
+
+	if (!ok)
+		return 1;
+	std::cout << "image loader: ok\n";
+	return 0;
+}
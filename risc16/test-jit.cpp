@@ -0,0 +1,98 @@
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <cstdint>
+
+#define TEST_TICKS	300
+
+/* loop:	addi	r1, r1, 1
+ *	addi	r2, r2, 3
+ *	beq	r0, r0, loop */
+static const uint16_t LOOP[] = { 0x2481, 0x2903, 0xc07d };
+static const uint16_t ADDI_R1_2 = 0x2482;	/* addi r1, r1, 2 */
+static const uint16_t ADDI_R2_5 = 0x2905;	/* addi r2, r2, 5 */
+
+/*	addi	r1, r0, 9
+ *	sw	r1, r0, 1
+ *	halt */
+static const uint16_t ROM_STORE[] = { 0x2409, 0x8401, 0xe071 };
+
+struct machine {
+	mem_unit mem;
+	reg_unit reg;
+	ctrl_unit ctrl;
+
+	void load(const uint16_t *rom, const uint32_t words, const enum ENGINE engine)
+	{
+		this->mem.reset();
+		this->reg.reset();
+		this->ctrl.set_mem(&this->mem);
+		this->ctrl.set_reg(&this->reg);
+		this->ctrl.set_engine(engine);
+		this->mem.write_block(ROM_START, rom, words);
+	}
+};
+
+static bool same(machine &jit, machine &ref, const char *when)
+{
+	bool ok = (jit.reg.get_pc() == ref.reg.get_pc()) && (jit.ctrl.get_retired() == ref.ctrl.get_retired());
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		ok &= (jit.reg.read(i) == ref.reg.read(i));
+	for (uint16_t addr = ROM_START; addr < 4; addr++) {
+		uint16_t a, b;
+		jit.mem.read_block(addr, &a, 1);
+		ref.mem.read_block(addr, &b, 1);
+		ok &= (a == b);
+	}
+	if (!ok) {
+		std::cerr << "FAIL: " << when << ": jit at 0x" << std::hex << jit.reg.get_pc() << " $r1 0x"
+			  << jit.reg.read(1) << " $r2 0x" << jit.reg.read(2) << ", switch at 0x" << ref.reg.get_pc()
+			  << " $r1 0x" << ref.reg.read(1) << " $r2 0x" << ref.reg.read(2) << std::dec << "\n";
+	}
+	return ok;
+}
+
+/* a poke into a ROM block that is already translated has to reach the
+ * next run, and a program store into ROM has to fault without touching
+ * it, the same way it does under the switch core */
+int main(void)
+{
+	bool ok = true;
+	machine jit, ref;
+
+	jit.load(LOOP, sizeof(LOOP) / sizeof(LOOP[0]), ENG_JIT);
+	ref.load(LOOP, sizeof(LOOP) / sizeof(LOOP[0]), ENG_SWITCH);
+	jit.ctrl.run(TEST_TICKS);
+	ref.ctrl.run(TEST_TICKS);
+	ok &= same(jit, ref, "first run");
+
+	/* the first word heads the block, the second sits inside it */
+	jit.mem.write(0, ADDI_R1_2, true);
+	ref.mem.write(0, ADDI_R1_2, true);
+	jit.ctrl.run(TEST_TICKS);
+	ref.ctrl.run(TEST_TICKS);
+	ok &= same(jit, ref, "poke at block start");
+
+	jit.mem.write(1, ADDI_R2_5, true);
+	ref.mem.write(1, ADDI_R2_5, true);
+	jit.ctrl.run(TEST_TICKS);
+	ref.ctrl.run(TEST_TICKS);
+	ok &= same(jit, ref, "poke inside block");
+
+	jit.load(ROM_STORE, sizeof(ROM_STORE) / sizeof(ROM_STORE[0]), ENG_JIT);
+	ref.load(ROM_STORE, sizeof(ROM_STORE) / sizeof(ROM_STORE[0]), ENG_SWITCH);
+	const enum STOP_REASON jit_stop = jit.ctrl.run(TEST_TICKS);
+	const enum STOP_REASON ref_stop = ref.ctrl.run(TEST_TICKS);
+	if (jit_stop != ref_stop) {
+		std::cerr << "FAIL: store into ROM: jit " << stop2str(jit_stop) << ", switch "
+			  << stop2str(ref_stop) << "\n";
+		ok = false;
+	}
+	ok &= same(jit, ref, "store into ROM");
+
+	if (!ok)
+		return 1;
+	std::cout << "jit invalidation: ok\n";
+	return 0;
+}
@@ -0,0 +1,97 @@
+#include "lockstep.h"
+#include "cmdi.h"
+#include "cond.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#define TEST_BUDGET	40	/* low enough that the longer lanes run out */
+#define TEST_INPUT	0x3000
+#define TEST_LOOP	0x0004
+#define TEST_COND	"r1 == 2 && r3 > 10"	/* only some lanes get there */
+
+/*	movi	r2, 0x3000
+ *	lw	r1, r2, 0
+ *	nand	r4, r0, r0
+ * loop:	beq	r1, r0, done
+ *	add	r3, r3, r1
+ *	sw	r3, r2, 1
+ *	add	r1, r1, r4
+ *	beq	r0, r0, loop
+ * done:	halt */
+static const uint16_t ROM[] = { 0x68c0, 0x2900, 0xa500, 0x5000, 0xc404,
+				0x0d81, 0x8d01, 0x0484, 0xc07b, 0xe071 };
+
+/* every lane loops a different number of times, so lanes split at the beq,
+ * halt at different points, stop at the conditional breakpoint or hit the
+ * budget, and must still end exactly where the switch core ends with the
+ * same input */
+int main(void)
+{
+	bool ok = true;
+	std::vector<uint16_t> image(MEM_CAPACITY, 0);
+	std::copy_n(ROM, sizeof(ROM) / sizeof(ROM[0]), image.begin());
+	const uint16_t rx[N_OF_REGS] = { 0 };
+
+	lockstep_unit lanes;
+	for (uint32_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+		image[TEST_INPUT] = lane * 2;
+		lanes.load(lane, image.data(), ROM_START, rx);
+	}
+	std::bitset<MEM_CAPACITY> bpoints;
+	std::map<uint16_t, struct bp_cond> conds;
+	bpoints.set(TEST_LOOP);
+	conds[TEST_LOOP].src = TEST_COND;
+	if (cond_compile(TEST_COND, std::map<uint16_t, std::string>(), conds[TEST_LOOP].code) != E_OK) {
+		std::cerr << "FAIL: condition \"" TEST_COND "\"\n";
+		return 1;
+	}
+	lanes.run(TEST_BUDGET, bpoints, conds);
+
+	for (uint32_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+		mem_unit mem;
+		reg_unit reg;
+		ctrl_unit ctrl;
+
+		mem.reset();
+		reg.reset();
+		ctrl.set_mem(&mem);
+		ctrl.set_reg(&reg);
+		image[TEST_INPUT] = lane * 2;
+		mem.write_block(0, image.data(), MEM_CAPACITY);
+		ctrl.set_condition(TEST_LOOP, TEST_COND);
+		const enum STOP_REASON reason = ctrl.run(TEST_BUDGET);
+
+		if (lanes.get_reason(lane) != reason || lanes.get_retired(lane) != ctrl.get_retired() ||
+		    lanes.get_pc(lane) != reg.get_pc()) {
+			std::cerr << "FAIL: lane " << lane << " stopped " << stop2str(lanes.get_reason(lane))
+				  << " after " << lanes.get_retired(lane) << " at 0x" << std::hex << lanes.get_pc(lane)
+				  << ", expected " << stop2str(reason) << " after " << std::dec << ctrl.get_retired()
+				  << " at 0x" << std::hex << reg.get_pc() << std::dec << "\n";
+			ok = false;
+		}
+		for (uint16_t i = 0; i < N_OF_REGS; i++) {
+			if (lanes.read_reg(lane, i) != reg.read(i)) {
+				std::cerr << "FAIL: lane " << lane << " $r" << i << " 0x" << std::hex
+					  << lanes.read_reg(lane, i) << " expected 0x" << reg.read(i) << std::dec << "\n";
+				ok = false;
+			}
+		}
+		for (uint32_t addr = 0; addr < MEM_CAPACITY; addr++) {
+			uint16_t word;
+			mem.read_block(addr, &word, 1);
+			if (lanes.read(lane, addr) != word) {
+				std::cerr << "FAIL: lane " << lane << " 0x" << std::hex << addr << " 0x"
+					  << lanes.read(lane, addr) << " expected 0x" << word << std::dec << "\n";
+				ok = false;
+			}
+		}
+	}
+	if (!ok)
+		return 1;
+	std::cout << "lockstep vs switch: ok\n";
+	return 0;
+}
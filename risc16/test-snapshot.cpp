@@ -0,0 +1,129 @@
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#define TEST_PATH	"test-snapshot.snap"
+#define TEST_AHEAD	6
+#define TEST_TICKS	1000
+#define TEST_INPUT	0x3000
+#define TEST_LOOP	0x0004
+#define TEST_COND	"r1 == 2 && [0x3001] > 10"
+
+/*	movi	r2, 0x3000
+ *	lw	r1, r2, 0
+ *	nand	r4, r0, r0
+ * loop:	beq	r1, r0, done
+ *	add	r3, r3, r1
+ *	sw	r3, r2, 1
+ *	add	r1, r1, r4
+ *	beq	r0, r0, loop
+ * done:	halt */
+static const uint16_t ROM[] = { 0x68c0, 0x2900, 0xa500, 0x5000, 0xc404,
+				0x0d81, 0x8d01, 0x0484, 0xc07b, 0xe071 };
+
+struct machine {
+	mem_unit mem;
+	reg_unit reg;
+	ctrl_unit ctrl;
+
+	machine(void)
+	{
+		this->mem.reset();
+		this->reg.reset();
+		this->ctrl.set_mem(&this->mem);
+		this->ctrl.set_reg(&this->reg);
+	}
+};
+
+static bool same(machine &a, machine &b, const char *when)
+{
+	bool ok = (a.reg.get_pc() == b.reg.get_pc());
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		ok &= (a.reg.read(i) == b.reg.read(i));
+	std::vector<uint16_t> ma(MEM_CAPACITY), mb(MEM_CAPACITY);
+	a.mem.read_block(0, ma.data(), MEM_CAPACITY);
+	b.mem.read_block(0, mb.data(), MEM_CAPACITY);
+	ok &= (ma == mb);
+	if (!ok) {
+		std::cerr << "FAIL: " << when << ": at 0x" << std::hex << a.reg.get_pc() << " $r1 0x" << a.reg.read(1)
+			  << ", expected 0x" << b.reg.get_pc() << " $r1 0x" << b.reg.read(1) << std::dec << "\n";
+	}
+	return ok;
+}
+
+static bool rejects(machine &m, const std::vector<char> &file, const char *what)
+{
+	std::ofstream(TEST_PATH, std::ios::binary | std::ios::trunc).write(file.data(), file.size());
+	if (m.ctrl.load_snapshot(TEST_PATH) == E_OK) {
+		std::cerr << "FAIL: loaded a snapshot with " << what << "\n";
+		return false;
+	}
+	return true;
+}
+
+/* a snapshot taken mid-run restores memory, registers and a conditional
+ * breakpoint into a fresh machine that then stops where the original does;
+ * damaged files are refused and leave the machine alone */
+int main(void)
+{
+	bool ok = true;
+	machine orig, copy;
+	const uint16_t input = 6;
+
+	orig.mem.write_block(ROM_START, ROM, sizeof(ROM) / sizeof(ROM[0]));
+	orig.mem.write_block(TEST_INPUT, &input, 1);
+	if (orig.ctrl.set_condition(TEST_LOOP, TEST_COND) != E_OK) {
+		std::cerr << "FAIL: condition \"" TEST_COND "\"\n";
+		return 1;
+	}
+	orig.ctrl.run(TEST_AHEAD);
+	if (orig.ctrl.save_snapshot(TEST_PATH) != E_OK) {
+		std::cerr << "FAIL: save " TEST_PATH "\n";
+		return 1;
+	}
+
+	if (copy.ctrl.load_snapshot(TEST_PATH) != E_OK) {
+		std::cerr << "FAIL: load " TEST_PATH "\n";
+		return 1;
+	}
+	ok &= same(copy, orig, "after load");
+
+	const enum STOP_REASON orig_stop = orig.ctrl.run(TEST_TICKS);
+	const enum STOP_REASON copy_stop = copy.ctrl.run(TEST_TICKS);
+	if (orig_stop != STOP_BREAK || copy_stop != STOP_BREAK) {
+		std::cerr << "FAIL: stopped " << stop2str(copy_stop) << " and " << stop2str(orig_stop)
+			  << ", expected " << stop2str(STOP_BREAK) << "\n";
+		ok = false;
+	}
+	ok &= same(copy, orig, "at the breakpoint");
+	if (copy.reg.get_pc() != TEST_LOOP || copy.reg.read(1) != 2) {
+		std::cerr << "FAIL: condition stopped at 0x" << std::hex << copy.reg.get_pc() << " with $r1 0x"
+			  << copy.reg.read(1) << std::dec << "\n";
+		ok = false;
+	}
+
+	std::ifstream in(TEST_PATH, std::ios::binary);
+	const std::vector<char> good((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	std::vector<char> bad = good;
+	bad.back() ^= 1;
+	ok &= rejects(copy, bad, "a flipped bit");
+	bad = good;
+	bad.pop_back();
+	ok &= rejects(copy, bad, "a missing byte");
+	bad = good;
+	bad[4] ^= 0xff;
+	ok &= rejects(copy, bad, "a wrong version");
+	ok &= same(copy, orig, "after rejected loads");
+	std::remove(TEST_PATH);
+
+	if (!ok)
+		return 1;
+	std::cout << "snapshot round trip: ok\n";
+	return 0;
+}
@@ -0,0 +1,121 @@
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define TEST_PATH	"test-trace.bin"
+#define TEST_TICKS	60
+#define TEST_INPUT	0x3000
+
+/*	movi	r2, 0x3000
+ *	lw	r1, r2, 0
+ *	nand	r4, r0, r0
+ * loop:	beq	r1, r0, done
+ *	add	r3, r3, r1
+ *	sw	r3, r2, 1
+ *	add	r1, r1, r4
+ *	beq	r0, r0, loop
+ * done:	halt */
+static const uint16_t ROM[] = { 0x68c0, 0x2900, 0xa500, 0x5000, 0xc404,
+				0x0d81, 0x8d01, 0x0484, 0xc07b, 0xe071 };
+
+struct machine {
+	mem_unit mem;
+	reg_unit reg;
+	ctrl_unit ctrl;
+
+	machine(void)
+	{
+		const uint16_t input = 5;
+		this->mem.reset();
+		this->reg.reset();
+		this->ctrl.set_mem(&this->mem);
+		this->ctrl.set_reg(&this->reg);
+		this->mem.write_block(ROM_START, ROM, sizeof(ROM) / sizeof(ROM[0]));
+		this->mem.write_block(TEST_INPUT, &input, 1);
+	}
+};
+
+/* what trace-dump should print for the next instruction, without the
+ * disassembly in the middle */
+static void expect(machine &m, const uint64_t index, std::string &head, std::string &tail)
+{
+	const uint16_t pc = m.reg.get_pc();
+	uint16_t word;
+	m.mem.read_block(pc, &word, 1);
+	instr_t in;
+	in.decode(word);
+	const uint16_t addr = in.imm + m.reg.read(in.rB);
+
+	char line[64];
+	snprintf(line, sizeof(line), "%llu 0x%04x: 0x%04x  ", static_cast<unsigned long long>(index), pc, word);
+	head = line;
+	tail.clear();
+	if (in.opcode == __LW) {
+		snprintf(line, sizeof(line), "\t[ld 0x%04x]", addr);
+		tail = line;
+	} else if (in.opcode == __SW) {
+		snprintf(line, sizeof(line), "\t[st 0x%04x <- 0x%04x]", addr, m.reg.read(in.rA));
+		tail = line;
+	}
+}
+
+/* one machine runs with a trace while a twin single steps through the same
+ * program, trace-dump has to read back one line per retired instruction */
+int main(void)
+{
+	bool ok = true;
+	machine traced, twin;
+
+	if (traced.ctrl.set_trace(TEST_PATH) != E_OK) {
+		std::cerr << "FAIL: open " TEST_PATH "\n";
+		return 1;
+	}
+	traced.ctrl.run(TEST_TICKS);
+	if (traced.ctrl.save_trace() != E_OK) {
+		std::cerr << "FAIL: write " TEST_PATH "\n";
+		return 1;
+	}
+
+	FILE *dump = popen("./trace-dump " TEST_PATH, "r");
+	if (!dump) {
+		std::cerr << "FAIL: run trace-dump\n";
+		return 1;
+	}
+	char buf[128];
+	std::string head, tail;
+	uint64_t index = 0;
+	while (fgets(buf, sizeof(buf), dump)) {
+		std::string line(buf);
+		line.pop_back();
+		expect(twin, index, head, tail);
+		if (line.compare(0, head.size(), head) || line.size() < tail.size() ||
+		    line.compare(line.size() - tail.size(), tail.size(), tail)) {
+			std::cerr << "FAIL: \"" << line << "\", expected \"" << head << "...\"" << tail << "\"\n";
+			ok = false;
+			break;
+		}
+		if (twin.ctrl.run(1) != STOP_BUDGET)
+			break;
+		index++;
+	}
+	const int status = pclose(dump);
+	std::remove(TEST_PATH);
+
+	if (status != 0) {
+		std::cerr << "FAIL: trace-dump exited with " << status << "\n";
+		ok = false;
+	}
+	if (index + 1 != traced.ctrl.get_retired()) {
+		std::cerr << "FAIL: " << index + 1 << " records, expected " << traced.ctrl.get_retired() << "\n";
+		ok = false;
+	}
+	if (!ok)
+		return 1;
+	std::cout << "trace round trip: ok\n";
+	return 0;
+}
@@ -0,0 +1,91 @@
+#include "cmdi.h"
+#include "timing.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <cstdint>
+#include <vector>
+
+#define TEST_DEPTH	16	/* undo ring entries, far fewer than stepped back */
+#define TEST_AHEAD	200
+#define TEST_BACK	150
+
+/*	lui	r2, 0x2100
+ * loop:	sys	2
+ *	sw	r1, r2, 0
+ *	addi	r2, r2, 1
+ *	beq	r0, r0, loop */
+static const uint16_t ROM[] = { 0x6884, 0xe012, 0x8500, 0x2901, 0xc07c };
+
+struct machine_state {
+	uint16_t pc;
+	uint16_t rx[N_OF_REGS];
+	std::vector<uint16_t> mem;
+};
+
+static void save(mem_unit &mem, reg_unit &reg, struct machine_state &state)
+{
+	state.pc = reg.get_pc();
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		state.rx[i] = reg.read(i);
+	state.mem.resize(MEM_CAPACITY);
+	mem.read_block(0, state.mem.data(), MEM_CAPACITY);
+}
+
+/* steps back across GETCs the undo ring no longer holds, the replay from
+ * the checkpoint has to see the same input as the first run and must not
+ * be counted by the timing model again */
+int main(void)
+{
+	mem_unit mem;
+	reg_unit reg;
+	ctrl_unit ctrl;
+	uint16_t input = 0;
+
+	mem.reset();
+	reg.reset();
+	ctrl.set_mem(&mem);
+	ctrl.set_reg(&reg);
+	mem.write_block(ROM_START, ROM, sizeof(ROM) / sizeof(ROM[0]));
+	ctrl.set_syscall(SYS_GETC, [&input](const uint16_t arg) {
+		return input += 7;
+	});
+	ctrl.set_undo(TEST_DEPTH);
+	ctrl.set_timing("/dev/null", timing_rules());
+
+	struct machine_state before, after;
+	ctrl.run(TEST_AHEAD - TEST_BACK);
+	save(mem, reg, before);
+	ctrl.run(TEST_BACK);
+	const uint64_t cycles = ctrl.get_cycles();
+
+	if (ctrl.step_back(TEST_BACK) != E_OK) {
+		std::cerr << "FAIL: step back " << TEST_BACK << "\n";
+		return 1;
+	}
+	save(mem, reg, after);
+
+	bool ok = (ctrl.get_retired() == TEST_AHEAD - TEST_BACK) && (before.pc == after.pc);
+	if (ctrl.get_cycles() != cycles) {
+		std::cerr << "FAIL: " << ctrl.get_cycles() << " cycles after replay, expected " << cycles << "\n";
+		ok = false;
+	}
+	for (uint16_t i = 0; i < N_OF_REGS; i++) {
+		if (before.rx[i] != after.rx[i]) {
+			std::cerr << "FAIL: $r" << i << " 0x" << std::hex << after.rx[i]
+				  << " expected 0x" << before.rx[i] << std::dec << "\n";
+			ok = false;
+		}
+	}
+	for (uint32_t addr = 0; addr < MEM_CAPACITY; addr++) {
+		if (before.mem[addr] != after.mem[addr]) {
+			std::cerr << "FAIL: 0x" << std::hex << addr << " 0x" << after.mem[addr]
+				  << " expected 0x" << before.mem[addr] << std::dec << "\n";
+			ok = false;
+		}
+	}
+	if (!ok)
+		return 1;
+	std::cout << "undo replay: ok\n";
+	return 0;
+}
@@ -0,0 +1,74 @@
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <cstdint>
+
+#define TEST_TICKS	100
+
+/*	movi	r2, 0x3000
+ *	addi	r1, r0, 5
+ *	lw	r3, r2, 1
+ *	sw	r1, r2, 0
+ *	halt */
+static const uint16_t ROM[] = { 0x68c0, 0x2900, 0x2405, 0xad01, 0x8500, 0xe071 };
+
+struct watch_case {
+	uint16_t addr;
+	uint8_t kind;
+	enum STOP_REASON stop;
+	uint16_t pc;		/* where the run stops, past the accessing instruction */
+	uint8_t hit;		/* kind reported, WATCH_NONE when it doesn't stop */
+};
+
+static const struct watch_case CASES[] = {
+	{ 0x3000, WATCH_W,	STOP_WATCH,	0x0005, WATCH_W },
+	{ 0x3001, WATCH_R,	STOP_WATCH,	0x0004, WATCH_R },
+	{ 0x3001, WATCH_RW,	STOP_WATCH,	0x0004, WATCH_R },
+	{ 0x3000, WATCH_R,	STOP_HALT,	0x0005, WATCH_NONE },	/* only ever written */
+	{ 0x3002, WATCH_RW,	STOP_HALT,	0x0005, WATCH_NONE },	/* same page, never touched */
+};
+
+static const enum ENGINE ENGINES[] = { ENG_SWITCH, ENG_THREADED, ENG_JIT };
+static const char *ENGINE_NAMES[] = { "switch", "threaded", "jit" };
+
+/* every engine stops once the instruction touching a watched word has
+ * retired, and resumes to the end from there */
+int main(void)
+{
+	bool ok = true;
+	for (auto const& engine : ENGINES) {
+		for (auto const& it : CASES) {
+			mem_unit mem;
+			reg_unit reg;
+			ctrl_unit ctrl;
+
+			mem.reset();
+			reg.reset();
+			ctrl.set_mem(&mem);
+			ctrl.set_reg(&reg);
+			ctrl.set_engine(engine);
+			mem.write_block(ROM_START, ROM, sizeof(ROM) / sizeof(ROM[0]));
+			mem.add_watch(it.addr, it.kind);
+
+			const enum STOP_REASON stop = ctrl.run(TEST_TICKS);
+			const bool hit = (stop == STOP_WATCH);
+			if (stop != it.stop || reg.get_pc() != it.pc || (hit && (ctrl.get_watch_addr() != it.addr ||
+			    ctrl.get_watch_kind() != it.hit))) {
+				std::cerr << "FAIL: " << ENGINE_NAMES[engine] << " watching 0x" << std::hex << it.addr
+					  << " stopped " << stop2str(stop) << " at 0x" << reg.get_pc() << std::dec << "\n";
+				ok = false;
+				continue;
+			}
+			if (hit && ctrl.run(TEST_TICKS) != STOP_HALT) {
+				std::cerr << "FAIL: " << ENGINE_NAMES[engine] << " watching 0x" << std::hex << it.addr
+					  << std::dec << " doesn't resume to the halt\n";
+				ok = false;
+			}
+		}
+	}
+	if (!ok)
+		return 1;
+	std::cout << "watchpoints: ok\n";
+	return 0;
+}
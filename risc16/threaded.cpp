@@ -0,0 +1,158 @@
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <algorithm>
+
+/* direct-threaded interpreter core
+ *
+ * every address owns a pointer to the label that executes it; stale or
+ * never executed addresses point at the decode label which fills in the
+ * predecoded instruction and patches the pointer. handlers work on the
+ * register file directly, r0 stays zero because nothing ever writes it */
+
+#define NEXT()							\
+	do {							\
+		if (++done == ticks)				\
+			goto out;				\
+		if (has_bp && this->bpoints.test(pc) &&		\
+		    this->at_break(pc)) {			\
+			reason = STOP_BREAK;			\
+			goto out;				\
+		}						\
+		in = &this->dcache[pc];				\
+		goto *this->tcode[pc];				\
+	} while (0)
+
+/* a watched load or store ends the run once it retired */
+#define WATCHED()						\
+	do {							\
+		if (this->trap) {				\
+			reason = this->trap;			\
+			done++;					\
+			goto out;				\
+		}						\
+	} while (0)
+
+enum STOP_REASON ctrl_unit::run_threaded(const uint64_t ticks)
+{
+	static const void *const handlers[] = {
+		&&op_add, &&op_addi, &&op_nand, &&op_lui,
+		&&op_sw, &&op_lw, &&op_beq, &&op_jalr,
+		&&op_ext
+	};
+	if (!this->tdecode) {
+		this->tdecode = &&op_decode;
+		this->flush_dcache();
+	}
+
+	enum STOP_REASON reason = STOP_BUDGET;
+	uint16_t *rx = this->reg->rx.data();
+	uint16_t pc = this->reg->pc;
+	uint16_t last = this->mem->rom_ptr;
+	uint16_t addr;
+	uint64_t done = 0;
+	const bool has_bp = this->bpoints.any();
+	const instr_t *in = &this->instr;
+
+	if (ticks == 0)
+		goto out;
+	if (has_bp && this->bpoints.test(pc) && this->at_break(pc)) {
+		reason = STOP_BREAK;
+		goto out;
+	}
+	in = &this->dcache[pc];
+	goto *this->tcode[pc];
+
+op_decode:
+	if (this->dcache[pc].decode(this->mem->read(pc)) != E_OK) {
+		reason = STOP_FAULT;
+		goto out;
+	}
+	this->hcode[pc] = select(this->dcache[pc]);
+	this->dvalid.set(pc);
+	this->tcode[pc] = handlers[in->opcode];
+	goto *this->tcode[pc];
+
+op_add:
+	if (in->rA)
+		rx[in->rA] = rx[in->rB] + rx[in->rC];
+	last = pc++;
+	NEXT();
+
+op_addi:
+	if (in->rA)
+		rx[in->rA] = rx[in->rB] + in->imm;
+	last = pc++;
+	NEXT();
+
+op_nand:
+	if (in->rA)
+		rx[in->rA] = ~(rx[in->rB] & rx[in->rC]);
+	last = pc++;
+	NEXT();
+
+op_lui:
+	if (in->rA)
+		rx[in->rA] = (in->imm << 6) & MASK_LUI;
+	last = pc++;
+	NEXT();
+
+op_sw:
+	addr = in->imm + rx[in->rB];
+	this->mem->ram_ptr = addr;
+	if (addr >= RAM_START && addr < RAM_END)
+		this->mem->write(addr, rx[in->rA], false);
+	last = pc++;
+	WATCHED();
+	NEXT();
+
+op_lw:
+	addr = in->imm + rx[in->rB];
+	this->mem->ram_ptr = addr;
+	addr = this->mem->read(addr);
+	if (in->rA)
+		rx[in->rA] = addr;
+	last = pc++;
+	WATCHED();
+	NEXT();
+
+op_beq:
+	last = pc;
+	if (rx[in->rA] == rx[in->rB])
+		pc = pc + 1 + in->imm;
+	else
+		pc++;
+	NEXT();
+
+op_jalr:
+	/* in case if rA == rB */
+	addr = pc + 1;
+	last = pc;
+	pc = rx[in->rB];
+	if (in->rA)
+		rx[in->rA] = addr;
+	NEXT();
+
+op_ext:
+	/* rare enough to go through the switch core's handler */
+	this->reg->pc = pc;
+	this->instr = *in;
+	this->__ext();
+	last = pc;
+	pc = this->reg->pc;
+	if (this->trap) {
+		reason = this->trap;
+		done++;
+		goto out;
+	}
+	NEXT();
+
+out:
+	this->reg->touch();
+	this->reg->pc = pc;
+	this->mem->rom_ptr = last;
+	this->instr = *in;
+	this->retired += done;
+	return reason;
+}
@@ -0,0 +1,233 @@
+#include "timing.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+static const char *HAZNAMES[N_HAZARDS] = { "load-use", "data", "branch", "jump" };
+
+timing_unit::timing_unit(mem_unit *mem, const char *path, const struct timing_rules &rules)
+{
+	this->mem = mem;
+	this->path = std::string(path);
+	this->rules = rules;
+	this->pcs.assign(MEM_CAPACITY, timing_pc());
+}
+
+/* earliest ID cycle that can read reg in stage */
+uint64_t timing_unit::operand(const uint8_t reg, const enum STAGE stage, bool &load)
+{
+	if (!reg)
+		return 0;
+
+	uint64_t at = this->written[reg];
+	if (this->rules.forward) {
+		const uint64_t bypass = this->ready[reg] + 1;
+		at = (bypass > stage) ? bypass - stage : 0;
+	}
+	load = this->loaded[reg];
+	return at;
+}
+
+/* called for every instruction before it executes */
+void timing_unit::issue(const uint16_t pc, const instr_t &instr, const bool taken)
+{
+	struct timing_pc &at = this->pcs[pc];
+	uint64_t id = std::max(this->id_cycle + 1, this->fetch_at);
+
+	/* operands by the stage they are needed in */
+	uint8_t regs[2] = { 0, 0 };
+	enum STAGE stages[2] = { ST_EX, ST_EX };
+	switch (instr.opcode) {
+	case __ADD:
+	case __NAND:
+		regs[0] = instr.rB;
+		regs[1] = instr.rC;
+		break;
+	case __ADDI:
+	case __LW:
+		regs[0] = instr.rB;
+		break;
+	case __SW:
+		regs[0] = instr.rB;
+		regs[1] = instr.rA;
+		stages[1] = ST_MEM;
+		break;
+	case __BEQ:
+		regs[0] = instr.rA;
+		regs[1] = instr.rB;
+		stages[0] = stages[1] = this->rules.resolve;
+		break;
+	case __JALR:
+		regs[0] = instr.rB;
+		stages[0] = this->rules.resolve;
+		break;
+
+	default:
+		break;
+	};
+
+	uint64_t need = id;
+	bool load = false;
+	for (uint8_t i = 0; i < 2; i++) {
+		bool from_lw = false;
+		const uint64_t ok = this->operand(regs[i], stages[i], from_lw);
+		if (ok > need) {
+			need = ok;
+			load = from_lw;
+		}
+	}
+	if (need > id) {
+		const enum HAZARD kind = load ? HZ_LOAD_USE : HZ_DATA;
+		this->stalls[kind] += need - id;
+		at.stalls[kind] += need - id;
+		id = need;
+	}
+
+	const bool writes = instr.rA && instr.opcode != __SW && instr.opcode != __BEQ;
+	if (writes) {
+		const bool is_lw = (instr.opcode == __LW);
+		this->ready[instr.rA] = id + (is_lw ? ST_MEM : ST_EX);
+		this->written[instr.rA] = id + 3;
+		this->loaded[instr.rA] = is_lw;
+	}
+
+	/* the instruction after a redirect is fetched once the target is known */
+	uint64_t bubbles = 0;
+	if (instr.opcode == __BEQ && (taken || !this->rules.predict))
+		bubbles = this->rules.resolve + 1;
+	else if (instr.opcode == __JALR)
+		bubbles = this->rules.resolve + 1;
+	if (bubbles) {
+		const enum HAZARD kind = (instr.opcode == __BEQ) ? HZ_BRANCH : HZ_JUMP;
+		this->stalls[kind] += bubbles;
+		at.stalls[kind] += bubbles;
+	}
+	this->fetch_at = id + 1 + bubbles;
+
+	this->id_cycle = id;
+	this->total++;
+	at.count++;
+}
+
+/* cycles until the last instruction leaves WB */
+uint64_t timing_unit::get_cycles(void)
+{
+	return this->total ? this->id_cycle + PIPE_STAGES - 1 : 0;
+}
+
+/* totals and hazards, then every pc that stalled, worst first */
+enum GEN_ERR timing_unit::save(void)
+{
+	std::ofstream file(this->path, std::ios::trunc);
+	if (!file.is_open())
+		return E_IO;
+
+	char line[128];
+	const uint64_t cycles = this->get_cycles();
+	const double total = this->total ? this->total : 1;
+	snprintf(line, sizeof(line), "# %llu instructions, %llu cycles, CPI %.3f\n",
+		 static_cast<unsigned long long>(this->total), static_cast<unsigned long long>(cycles),
+		 cycles / total);
+	file << line;
+	snprintf(line, sizeof(line), "# forwarding %s, branches resolved in %s, %s\n\n",
+		 this->rules.forward ? "on" : "off", (this->rules.resolve == ST_ID) ? "ID" : "EX",
+		 this->rules.predict ? "predict not taken" : "stall until resolved");
+	file << line;
+
+	const double all = cycles ? cycles : 1;
+	file << "#  hazard           cycles       %\n";
+	for (uint8_t kind = 0; kind < N_HAZARDS; kind++) {
+		snprintf(line, sizeof(line), "   %-9s %14llu %6.2f\n", HAZNAMES[kind],
+			 static_cast<unsigned long long>(this->stalls[kind]), 100.0 * this->stalls[kind] / all);
+		file << line;
+	}
+	const uint64_t fill = this->total ? PIPE_STAGES - 1 : 0;
+	snprintf(line, sizeof(line), "   %-9s %14llu %6.2f\n", "fill",
+		 static_cast<unsigned long long>(fill), 100.0 * fill / all);
+	file << line;
+
+	std::vector<uint16_t> hot;
+	std::vector<uint64_t> lost(MEM_CAPACITY, 0);
+	for (uint32_t pc = 0; pc < MEM_CAPACITY; pc++) {
+		for (uint8_t kind = 0; kind < N_HAZARDS; kind++)
+			lost[pc] += this->pcs[pc].stalls[kind];
+		if (lost[pc])
+			hot.push_back(pc);
+	}
+	std::stable_sort(hot.begin(), hot.end(), [&lost](uint16_t a, uint16_t b) {
+		return lost[a] > lost[b];
+	});
+
+	file << "\n#         count        stalls  load-use      data    branch      jump      pc    word  instruction\n";
+	for (auto const& pc : hot) {
+		const struct timing_pc &at = this->pcs[pc];
+		snprintf(line, sizeof(line), "  %12llu  %12llu  %8llu  %8llu  %8llu  %8llu  ",
+			 static_cast<unsigned long long>(at.count), static_cast<unsigned long long>(lost[pc]),
+			 static_cast<unsigned long long>(at.stalls[HZ_LOAD_USE]),
+			 static_cast<unsigned long long>(at.stalls[HZ_DATA]),
+			 static_cast<unsigned long long>(at.stalls[HZ_BRANCH]),
+			 static_cast<unsigned long long>(at.stalls[HZ_JUMP]));
+		file << line << disasm_at(this->mem, pc) << "\n";
+	}
+
+	return file ? E_OK : E_IO;
+}
+
+/* comma separated: forward, no-forward, resolve-id, resolve-ex, predict, no-predict */
+enum GEN_ERR str2rules(const char *str, struct timing_rules &rules)
+{
+	std::stringstream list(str);
+	std::string rule;
+	while (std::getline(list, rule, ',')) {
+		if (rule == "forward")
+			rules.forward = true;
+		else if (rule == "no-forward")
+			rules.forward = false;
+		else if (rule == "resolve-id")
+			rules.resolve = ST_ID;
+		else if (rule == "resolve-ex")
+			rules.resolve = ST_EX;
+		else if (rule == "predict")
+			rules.predict = true;
+		else if (rule == "no-predict")
+			rules.predict = false;
+		else
+			return E_ARG;
+	}
+	return E_OK;
+}
+
+/* control unit timing BEGIN */
+enum GEN_ERR ctrl_unit::set_timing(const char *path, const struct timing_rules &rules)
+{
+	if (!path) {
+		this->timing.reset();
+		return E_OK;
+	}
+	this->timing = std::make_unique<timing_unit>(this->mem, path, rules);
+	return E_OK;
+}
+
+enum GEN_ERR ctrl_unit::save_timing(void)
+{
+	if (!this->timing)
+		return E_OK;
+	return this->timing->save();
+}
+
+uint64_t ctrl_unit::get_cycles(void)
+{
+	return this->timing ? this->timing->get_cycles() : 0;
+}
+
+void ctrl_unit::timing_instr(void)
+{
+	const bool taken = this->instr.opcode == __BEQ &&
+			   this->reg->read(this->instr.rA) == this->reg->read(this->instr.rB);
+	this->timing->issue(this->reg->get_pc(), this->instr, taken);
+}
+/* control unit timing END */
@@ -0,0 +1,75 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "modules.h"
+#include "cmdi.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define PIPE_STAGES	5	/* IF ID EX MEM WB */
+
+/* stage an operand is read in or a branch is resolved in, as cycles after ID */
+enum STAGE {
+	ST_ID	= 0,
+	ST_EX	= 1,
+	ST_MEM	= 2
+};
+
+enum HAZARD {
+	HZ_LOAD_USE	= 0,	/* operand produced by the lw just ahead */
+	HZ_DATA		= 1,	/* any other read-after-write stall */
+	HZ_BRANCH	= 2,	/* beq fetch bubbles */
+	HZ_JUMP		= 3,	/* jalr fetch bubbles */
+	N_HAZARDS	= 4
+};
+
+/* stall and forwarding rules */
+struct timing_rules {
+	bool forward = true;		/* EX/MEM and MEM/WB bypasses to EX */
+	enum STAGE resolve = ST_EX;	/* where beq and jalr pick the next pc */
+	bool predict = true;		/* fetch on as if beq is not taken, else stall */
+};
+
+struct timing_pc {
+	uint64_t count;
+	uint64_t stalls[N_HAZARDS];
+};
+
+/* in-order single issue pipeline that only keeps time: every retired
+ * instruction enters ID one cycle after the one before it plus whatever
+ * stalls its operands and the previous branch impose */
+class timing_unit {
+private:
+	/* private members BEGIN */
+	mem_unit *mem = nullptr;
+	std::string path;
+	struct timing_rules rules;
+
+	uint64_t id_cycle = 0;		/* cycle the last instruction left ID */
+	uint64_t fetch_at = 0;		/* earliest ID cycle after a redirect */
+	uint64_t ready[N_OF_REGS] = { 0 };	/* last cycle before a bypass has the value */
+	uint64_t written[N_OF_REGS] = { 0 };	/* WB cycle of the last write */
+	bool loaded[N_OF_REGS] = { false };	/* last writer was a lw */
+
+	uint64_t total = 0;
+	uint64_t stalls[N_HAZARDS] = { 0 };
+	std::vector<struct timing_pc> pcs;
+	/* private members END */
+	/* private functions BEGIN */
+	uint64_t operand(const uint8_t reg, const enum STAGE stage, bool &load);
+	/* private functions END */
+public:
+	timing_unit(mem_unit *mem, const char *path, const struct timing_rules &rules);
+	~timing_unit(void) = default;
+
+	void issue(const uint16_t pc, const instr_t &instr, const bool taken);
+	uint64_t get_cycles(void);
+
+	enum GEN_ERR save(void);
+};
+
+enum GEN_ERR str2rules(const char *str, struct timing_rules &rules);
+
+#endif
@@ -0,0 +1,121 @@
+#include "trace.h"
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+static const char *USAGE = "Usage:\t./trace-dump <trace-file>\n";
+
+static bool get_varint(const std::vector<uint8_t> &buf, size_t &pos, int32_t &delta)
+{
+	uint32_t zz = 0;
+	for (uint32_t shift = 0; shift < 32; shift += 7) {
+		if (pos >= buf.size())
+			return false;
+		const uint8_t byte = buf[pos++];
+		zz |= static_cast<uint32_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			delta = static_cast<int32_t>(zz >> 1) ^ -static_cast<int32_t>(zz & 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool get_word(const std::vector<uint8_t> &buf, size_t &pos, uint16_t &word)
+{
+	if (pos + 2 > buf.size())
+		return false;
+	word = buf[pos] | (buf[pos + 1] << 8);
+	pos += 2;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	enum GEN_ERR retval = E_OK;
+	if (argc != 2) {
+		retval = E_ARG;
+		std::cerr << "ERR " << retval << ": no file given\n" << USAGE;
+		return retval;
+	}
+
+	std::ifstream file(argv[1], std::ios::binary);
+	if (!file.is_open()) {
+		retval = E_IO;
+		std::cerr << "ERR " << retval << ": file \"" << argv[1] << "\" not found\n";
+		return retval;
+	}
+	std::vector<uint8_t> buf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	struct trace_header hdr;
+	if (buf.size() < sizeof(hdr) || memcmp(buf.data(), TRACE_MAGIC, sizeof(hdr.magic))) {
+		retval = E_IO;
+		std::cerr << "ERR " << retval << ": not a trace \"" << argv[1] << "\"\n";
+		return retval;
+	}
+	memcpy(&hdr, buf.data(), sizeof(hdr));
+	if (hdr.version != TRACE_VERSION) {
+		retval = E_IO;
+		std::cerr << "ERR " << retval << ": unsupported trace version " << hdr.version << "\n";
+		return retval;
+	}
+
+	/* mirrors the encoder state */
+	std::vector<uint16_t> words(MEM_CAPACITY, 0);
+	uint16_t next_pc = 0;
+	uint16_t last_addr = 0;
+
+	uint64_t index = hdr.start;
+	size_t pos = sizeof(hdr);
+	char line[64];
+	instr_t instr;
+	while (pos < buf.size()) {
+		const uint8_t tag = buf[pos++];
+		uint16_t pc = next_pc;
+		int32_t delta = 0;
+		uint16_t value = 0;
+		bool ok = true;
+
+		if (tag & TR_JUMP) {
+			ok = get_varint(buf, pos, delta);
+			pc = next_pc + delta;
+		}
+		if (ok && (tag & TR_WORD))
+			ok = get_word(buf, pos, words[pc]);
+		if (ok && (tag & (TR_LOAD | TR_STORE))) {
+			ok = get_varint(buf, pos, delta);
+			last_addr += delta;
+		}
+		if (ok && (tag & TR_STORE))
+			ok = get_word(buf, pos, value);
+		if (!ok) {
+			retval = E_RANGE;
+			std::cerr << "ERR " << retval << ": truncated record " << index << "\n";
+			break;
+		}
+
+		instr.decode(words[pc]);
+		snprintf(line, sizeof(line), "%llu 0x%04x: 0x%04x  ",
+			 static_cast<unsigned long long>(index), pc, words[pc]);
+		std::cout << line;
+		instr.print(std::cout);
+		if (tag & TR_LOAD) {
+			snprintf(line, sizeof(line), "\t[ld 0x%04x]", last_addr);
+			std::cout << line;
+		} else if (tag & TR_STORE) {
+			snprintf(line, sizeof(line), "\t[st 0x%04x <- 0x%04x]", last_addr, value);
+			std::cout << line;
+		}
+		std::cout << "\n";
+
+		next_pc = pc + 1;
+		index++;
+	}
+	return retval;
+}
@@ -0,0 +1,149 @@
+#include "trace.h"
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <cstring>
+
+trace_unit::~trace_unit(void)
+{
+	this->close();
+}
+
+enum GEN_ERR trace_unit::open(const char *path, const uint64_t start)
+{
+	this->file.open(path, std::ios::binary | std::ios::trunc);
+	if (!this->file.is_open())
+		return E_IO;
+
+	struct trace_header hdr;
+	memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+	hdr.version = TRACE_VERSION;
+	hdr.reserved = 0;
+	hdr.start = start;
+	this->file.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+	if (!this->file)
+		return E_IO;
+
+	this->chunk.resize(TRACE_CHUNK);
+	this->used = 0;
+	this->next_pc = 0;
+	this->last_addr = 0;
+	this->words.assign(MEM_CAPACITY, 0);
+	this->done = false;
+	this->failed = false;
+	this->writer = std::thread(&trace_unit::write_loop, this);
+	return E_OK;
+}
+
+/* flushes what is left and waits for the writer */
+enum GEN_ERR trace_unit::close(void)
+{
+	if (!this->writer.joinable())
+		return E_OK;
+
+	this->handoff();
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->done = true;
+	}
+	this->cv.notify_all();
+	this->writer.join();
+	this->file.close();
+	return (this->failed || !this->file) ? E_IO : E_OK;
+}
+
+/* queues the current chunk and continues in a spare one, waiting only
+ * when the writer is TRACE_QUEUE chunks behind */
+void trace_unit::handoff(void)
+{
+	this->chunk.resize(this->used);
+
+	std::unique_lock<std::mutex> guard(this->lock);
+	this->cv.wait(guard, [this] { return this->full.size() < TRACE_QUEUE; });
+	this->full.push_back(std::move(this->chunk));
+	if (this->spare.empty()) {
+		this->chunk = std::vector<uint8_t>();
+	} else {
+		this->chunk = std::move(this->spare.back());
+		this->spare.pop_back();
+	}
+	guard.unlock();
+	this->cv.notify_all();
+
+	this->chunk.resize(TRACE_CHUNK);
+	this->used = 0;
+}
+
+void trace_unit::write_loop(void)
+{
+	std::unique_lock<std::mutex> guard(this->lock);
+	for (;;) {
+		this->cv.wait(guard, [this] { return this->done || !this->full.empty(); });
+		if (this->full.empty())
+			break;
+
+		std::vector<uint8_t> out = std::move(this->full.front());
+		this->full.pop_front();
+		guard.unlock();
+		this->cv.notify_all();
+
+		this->file.write(reinterpret_cast<const char *>(out.data()), out.size());
+		guard.lock();
+		if (!this->file)
+			this->failed = true;
+		this->spare.push_back(std::move(out));
+	}
+}
+
+/* control unit tracing BEGIN */
+enum GEN_ERR ctrl_unit::set_trace(const char *path)
+{
+	if (!path) {
+		this->trace.reset();
+		return E_OK;
+	}
+
+	this->trace = std::make_unique<trace_unit>();
+	if (this->trace->open(path, this->retired) != E_OK) {
+		this->trace.reset();
+		return E_IO;
+	}
+	return E_OK;
+}
+
+/* the writer only reports failed writes once it has been joined */
+enum GEN_ERR ctrl_unit::save_trace(void)
+{
+	if (!this->trace)
+		return E_OK;
+	const enum GEN_ERR retval = this->trace->close();
+	this->trace.reset();
+	return retval;
+}
+
+/* records the decoded instruction and the memory word it touches */
+void ctrl_unit::trace_instr(void)
+{
+	const uint16_t pc = this->reg->get_pc();
+	const uint16_t addr = this->instr.imm + this->reg->read(this->instr.rB);
+
+	switch (this->instr.opcode) {
+	case __LW:
+		this->trace->record(pc, this->instr.raw_data, TR_LOAD, addr, 0);
+		break;
+	case __SW:
+		if (addr >= RAM_START && addr < RAM_END) {
+			this->trace->record(pc, this->instr.raw_data, TR_STORE, addr,
+					    this->reg->read(this->instr.rA));
+			break;
+		}
+		this->trace->record(pc, this->instr.raw_data, 0, 0, 0);
+		break;
+
+	default:
+		this->trace->record(pc, this->instr.raw_data, 0, 0, 0);
+		break;
+	};
+}
+/* control unit tracing END */
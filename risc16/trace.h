@@ -0,0 +1,123 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "modules.h"
+
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* binary execution trace, the header in host byte order and the
+ * records byte by byte, little-endian
+ *
+ *	trace_header
+ *	records until end of file, each a tag byte followed by
+ *		TR_JUMP:	varint zigzag(pc - (prev_pc + 1))
+ *		TR_WORD:	uint16_t raw word, when it differs from the last
+ *				word seen at this pc (all words start at 0)
+ *		TR_LOAD:	varint zigzag(addr - prev_addr)
+ *		TR_STORE:	varint zigzag(addr - prev_addr), uint16_t value
+ */
+#define TRACE_MAGIC	"R16T"
+#define TRACE_VERSION	1
+
+#define TRACE_CHUNK	(1 << 20)	/* bytes handed to the writer at once */
+#define TRACE_QUEUE	8		/* full chunks before the core waits */
+#define TRACE_RECORD	12		/* longest possible record */
+
+enum TRACE_TAG {
+	TR_JUMP		= 0x01,
+	TR_WORD		= 0x02,
+	TR_LOAD		= 0x04,
+	TR_STORE	= 0x08
+};
+
+struct trace_header {
+	char magic[4];
+	uint16_t version;
+	uint16_t reserved;
+	uint64_t start;		/* retired count of the first record */
+};
+
+static_assert(sizeof(struct trace_header) == 16, "trace_header must stay packed");
+
+/* delta-encodes retired instructions into chunks that a background thread
+ * writes out, so the core only ever touches memory */
+class trace_unit {
+private:
+	/* private members BEGIN */
+	std::ofstream file;
+
+	std::vector<uint8_t> chunk;
+	size_t used = 0;
+
+	uint16_t next_pc = 0;
+	uint16_t last_addr = 0;
+	std::vector<uint16_t> words;
+
+	std::thread writer;
+	std::mutex lock;
+	std::condition_variable cv;
+	std::deque<std::vector<uint8_t>> full;
+	std::vector<std::vector<uint8_t>> spare;
+	bool done = false;
+	bool failed = false;
+	/* private members END */
+	/* private functions BEGIN */
+	void put_varint(int32_t delta);
+	void handoff(void);
+	void write_loop(void);
+	/* private functions END */
+public:
+	trace_unit(void) = default;
+	~trace_unit(void);
+
+	enum GEN_ERR open(const char *path, const uint64_t start);
+	enum GEN_ERR close(void);
+
+	/* called once per instruction: kept in the header so it inlines */
+	inline void record(const uint16_t pc, const uint16_t raw, const uint8_t kind,
+			   const uint16_t addr, const uint16_t value)
+	{
+		if (this->used > TRACE_CHUNK - TRACE_RECORD)
+			this->handoff();
+
+		uint8_t &tag = this->chunk[this->used++];
+		tag = kind;
+		if (pc != this->next_pc) {
+			tag |= TR_JUMP;
+			this->put_varint(static_cast<int16_t>(pc - this->next_pc));
+		}
+		if (raw != this->words[pc]) {
+			tag |= TR_WORD;
+			this->words[pc] = raw;
+			this->chunk[this->used++] = raw & 0xff;
+			this->chunk[this->used++] = raw >> 8;
+		}
+		if (kind & (TR_LOAD | TR_STORE)) {
+			this->put_varint(static_cast<int16_t>(addr - this->last_addr));
+			this->last_addr = addr;
+		}
+		if (kind & TR_STORE) {
+			this->chunk[this->used++] = value & 0xff;
+			this->chunk[this->used++] = value >> 8;
+		}
+		this->next_pc = pc + 1;
+	}
+};
+
+inline void trace_unit::put_varint(int32_t delta)
+{
+	uint32_t zz = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+	while (zz >= 0x80) {
+		this->chunk[this->used++] = (zz & 0x7f) | 0x80;
+		zz >>= 7;
+	}
+	this->chunk[this->used++] = zz;
+}
+
+#endif
@@ -0,0 +1,259 @@
+#include "undo.h"
+#include "cmdi.h"
+#include "gen-err.h"
+
+#include <cstdint>
+#include <algorithm>
+
+undo_unit::undo_unit(mem_unit *mem, reg_unit *reg, const size_t depth)
+{
+	this->mem = mem;
+	this->reg = reg;
+	this->ring.resize(depth ? depth : 1);
+}
+
+void undo_unit::record(const uint16_t pc, const uint8_t kind, const uint16_t addr, const uint16_t old)
+{
+	struct undo_entry &entry = this->ring[this->head];
+	entry.pc = pc;
+	entry.kind = kind;
+	entry.addr = addr;
+	entry.old = old;
+
+	if (++this->head == this->ring.size())
+		this->head = 0;
+	if (this->count < this->ring.size())
+		this->count++;
+}
+
+/* reverts the newest entry, false once the ring is empty */
+bool undo_unit::undo(void)
+{
+	if (!this->count)
+		return false;
+
+	this->head = (this->head ? this->head : this->ring.size()) - 1;
+	this->count--;
+
+	const struct undo_entry &entry = this->ring[this->head];
+	if (entry.kind == UNDO_REG)
+		this->reg->write(entry.addr, entry.old);
+	else if (entry.kind == UNDO_MEM)
+		this->mem->write(entry.addr, entry.old, true);
+	this->reg->set_pc(entry.pc);
+	this->mem->rom_ptr = entry.pc;
+	return true;
+}
+
+size_t undo_unit::size(void)
+{
+	return this->count;
+}
+
+void undo_unit::checkpoint(const uint64_t retired)
+{
+	if (!this->checkpoints.empty() && this->checkpoints.back().retired >= retired)
+		return;
+	if (this->checkpoints.size() == UNDO_CHECKPOINTS) {
+		this->checkpoints.pop_front();
+		/* nothing replays from before the oldest checkpoint anymore */
+		while (!this->results.empty() && this->results.front().retired < this->checkpoints.front().retired)
+			this->results.pop_front();
+	}
+
+	struct undo_checkpoint cp;
+	cp.retired = retired;
+	cp.pc = this->reg->get_pc();
+	for (uint16_t i = 0; i < N_OF_REGS; i++)
+		cp.rx[i] = this->reg->read(i);
+	cp.mem.resize(MEM_CAPACITY);
+	this->mem->read_block(0, cp.mem.data(), MEM_CAPACITY);
+	this->checkpoints.push_back(std::move(cp));
+}
+
+/* restores the newest checkpoint at or before target, the ring is emptied
+ * since it describes a different stretch of history; later checkpoints stay
+ * valid as replay is deterministic */
+bool undo_unit::restore(const uint64_t target, uint64_t &retired)
+{
+	for (auto it = this->checkpoints.rbegin(); it != this->checkpoints.rend(); it++) {
+		if (it->retired > target)
+			continue;
+
+		this->mem->write_block(0, it->mem.data(), MEM_CAPACITY);
+		for (uint16_t i = 1; i < N_OF_REGS; i++)
+			this->reg->write(i, it->rx[i]);
+		this->reg->set_pc(it->pc);
+		this->mem->rom_ptr = it->pc;
+		retired = it->retired;
+
+		this->head = 0;
+		this->count = 0;
+		return true;
+	}
+	return false;
+}
+
+/* a live syscall after going back starts a new history, results and
+ * checkpoints past it belong to the old one */
+void undo_unit::record_result(const uint64_t retired, const uint16_t value)
+{
+	while (!this->results.empty() && this->results.back().retired >= retired)
+		this->results.pop_back();
+	while (!this->checkpoints.empty() && this->checkpoints.back().retired > retired)
+		this->checkpoints.pop_back();
+	this->results.push_back({ retired, value });
+}
+
+/* what the syscall retired at that count got the first time around */
+bool undo_unit::replay_result(const uint64_t retired, uint16_t &value)
+{
+	auto it = std::lower_bound(this->results.begin(), this->results.end(), retired,
+				   [](const struct undo_result &res, const uint64_t at) {
+		return res.retired < at;
+	});
+	if (it == this->results.end() || it->retired != retired)
+		return false;
+	value = it->value;
+	return true;
+}
+
+void undo_unit::clear(void)
+{
+	this->head = 0;
+	this->count = 0;
+	this->checkpoints.clear();
+	this->results.clear();
+}
+
+/* control unit time travel BEGIN */
+void ctrl_unit::set_undo(const size_t depth)
+{
+	if (!depth) {
+		this->undo.reset();
+		return;
+	}
+	this->undo = std::make_unique<undo_unit>(this->mem, this->reg, depth);
+	this->undo->checkpoint(this->retired);
+}
+
+/* history no longer matches after pokes, $pc edits or snapshot loads */
+void ctrl_unit::clear_history(void)
+{
+	if (!this->undo)
+		return;
+	this->undo->clear();
+	this->undo->checkpoint(this->retired);
+}
+
+/* logs what the decoded instruction is about to overwrite */
+void ctrl_unit::record_undo(void)
+{
+	const uint16_t pc = this->reg->get_pc();
+	uint16_t addr = 0;
+
+	switch (this->instr.opcode) {
+	case __ADD:
+	case __ADDI:
+	case __NAND:
+	case __LUI:
+	case __LW:
+	case __JALR:
+		if (this->instr.rA)
+			this->undo->record(pc, UNDO_REG, this->instr.rA, this->reg->read(this->instr.rA));
+		else
+			this->undo->record(pc, UNDO_NONE, 0, 0);
+		break;
+	case __SW:
+		addr = this->instr.imm + this->reg->read(this->instr.rB);
+		if (addr >= RAM_START && addr < RAM_END) {
+			/* the backing word, a device read could have side effects */
+			uint16_t old;
+			this->mem->read_block(addr, &old, 1);
+			this->undo->record(pc, UNDO_MEM, addr, old);
+		} else
+			this->undo->record(pc, UNDO_NONE, 0, 0);
+		break;
+	case __EXT:
+		/* syscalls hand their result back in $r1 */
+		if ((this->instr.imm >> 4) == EXT_SYSCALL && (this->instr.imm & 0xf) != SYS_EXIT)
+			this->undo->record(pc, UNDO_REG, 1, this->reg->read(1));
+		else
+			this->undo->record(pc, UNDO_NONE, 0, 0);
+		break;
+
+	default:
+		this->undo->record(pc, UNDO_NONE, 0, 0);
+		break;
+	};
+}
+
+/* re-executes from the current state up to target, ignoring breakpoints */
+void ctrl_unit::replay_to(const uint64_t target)
+{
+	while (this->retired < target) {
+		if (this->step() != E_OK)
+			break;
+	}
+}
+
+enum GEN_ERR ctrl_unit::step_back(const uint64_t n)
+{
+	enum GEN_ERR retval = E_OK;
+	if (!this->undo)
+		return E_INIT;
+
+	/* devices already saw these stores once */
+	this->mem->set_mute(true);
+	const uint64_t target = (n > this->retired) ? 0 : this->retired - n;
+	if (this->retired - target <= this->undo->size()) {
+		while (this->retired > target && this->undo->undo())
+			this->retired--;
+	} else if (this->undo->restore(target, this->retired)) {
+		/* too far back for the ring: restore a checkpoint and replay */
+		this->replay_to(target);
+	} else {
+		retval = E_RANGE;
+	}
+	this->mem->set_mute(false);
+	return retval;
+}
+
+enum GEN_ERR ctrl_unit::run_back_to_break(void)
+{
+	enum GEN_ERR retval = E_RANGE;
+	if (!this->undo)
+		return E_INIT;
+
+	this->mem->set_mute(true);
+	/* walk the ring first */
+	while (retval != E_OK && this->undo->undo()) {
+		this->retired--;
+		if (this->bpoints.test(this->reg->get_pc()) && this->at_break(this->reg->get_pc()))
+			retval = E_OK;
+	}
+
+	/* then replay the stretches between older checkpoints, newest first,
+	 * remembering the last breakpoint hit in each */
+	uint64_t stop = this->retired;
+	while (retval != E_OK && stop && this->undo->restore(stop - 1, this->retired)) {
+		const uint64_t start = this->retired;
+		uint64_t hit = UINT64_MAX;
+		while (this->retired < stop) {
+			if (this->bpoints.test(this->reg->get_pc()) && this->at_break(this->reg->get_pc()))
+				hit = this->retired;
+			if (this->step() != E_OK)
+				break;
+		}
+		if (hit != UINT64_MAX)
+			retval = this->step_back(this->retired - hit);
+		stop = start;
+	}
+
+	/* no hit: stay at the oldest state still reachable */
+	if (retval != E_OK)
+		this->undo->restore(stop, this->retired);
+	this->mem->set_mute(false);
+	return retval;
+}
+/* control unit time travel END */
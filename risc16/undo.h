@@ -0,0 +1,72 @@
+#ifndef UNDO_H
+#define UNDO_H
+
+#include "modules.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#define UNDO_DEPTH		(1 << 20)	/* default ring entries */
+#define UNDO_INTERVAL		(1 << 20)	/* instructions between checkpoints */
+#define UNDO_CHECKPOINTS	8		/* checkpoints kept */
+
+enum UNDO_KIND {
+	UNDO_NONE	= 0,
+	UNDO_REG	= 1,
+	UNDO_MEM	= 2
+};
+
+/* side effect of one retired instruction */
+struct undo_entry {
+	uint16_t pc;	/* $pc before the instruction */
+	uint16_t addr;	/* register index or memory address */
+	uint16_t old;	/* value that got overwritten */
+	uint8_t kind;
+};
+
+/* what the host handed back for the syscall retired at some count */
+struct undo_result {
+	uint64_t retired;
+	uint16_t value;
+};
+
+/* full machine state at some retired count */
+struct undo_checkpoint {
+	uint64_t retired;
+	uint16_t pc;
+	uint16_t rx[N_OF_REGS];
+	std::vector<uint16_t> mem;
+};
+
+/* bounded undo history: a ring of per-instruction side effects plus a few
+ * periodic checkpoints to replay from once the ring runs dry */
+class undo_unit {
+private:
+	/* private members BEGIN */
+	mem_unit *mem = nullptr;
+	reg_unit *reg = nullptr;
+
+	std::vector<struct undo_entry> ring;
+	size_t head = 0;	/* next slot to write */
+	size_t count = 0;	/* valid entries behind head */
+
+	std::deque<struct undo_checkpoint> checkpoints;
+	std::deque<struct undo_result> results;	/* since the oldest checkpoint */
+	/* private members END */
+public:
+	undo_unit(mem_unit *mem, reg_unit *reg, const size_t depth);
+	~undo_unit(void) = default;
+
+	void record(const uint16_t pc, const uint8_t kind, const uint16_t addr, const uint16_t old);
+	bool undo(void);
+	size_t size(void);
+
+	void checkpoint(const uint64_t retired);
+	bool restore(const uint64_t target, uint64_t &retired);
+	void record_result(const uint64_t retired, const uint16_t value);
+	bool replay_result(const uint64_t retired, uint16_t &value);
+	void clear(void);
+};
+
+#endif
@@ -13,6 +13,8 @@
 
 #define X_STDOUT 60
 #define Y_STDOUT 12
+#define STDOUT_W 32
+#define STDOUT_H 8
 
 #define X_SCANIN 60
 #define Y_SCANIN 22